@@ -0,0 +1,138 @@
+#include <llvm/Support/Casting.h>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "global/Global.h"
+#include "parser/FlatExpr.h"
+#include "parser/Parser.h"
+
+using namespace kaso;
+using namespace kaso::parser;
+
+namespace {
+
+// a balanced tree of arithmetic over x, y, literals and calls, with an if
+// every few levels so codegen has blocks to switch between.
+void makeExpr(std::string& out, int depth, unsigned& seed) {
+  seed = seed * 1103515245 + 12345;
+  if (depth == 0) {
+    static const char* leaves[] = {"x", "y", "1.5", "g(x, y)"};
+    out += leaves[(seed >> 16) % 4];
+    return;
+  }
+  if (depth % 6 == 0) {
+    out += "(if x < y then ";
+    makeExpr(out, depth - 1, seed);
+    out += " else ";
+    makeExpr(out, depth - 1, seed);
+    out += ")";
+    return;
+  }
+  static const char* ops[] = {" + ", " - ", " * "};
+  out += "(";
+  makeExpr(out, depth - 1, seed);
+  out += ops[(seed >> 16) % 3];
+  makeExpr(out, depth - 1, seed);
+  out += ")";
+}
+
+// the kind of whole-tree analysis a pass does: sum every literal.
+double sumTree(const Expr& e) {
+  switch (e.kind()) {
+    case Expr::Kind::Number:
+      return llvm::cast<NumberExpr>(e).getVal();
+    case Expr::Kind::Binary: {
+      auto& b = llvm::cast<BinaryExpr>(e);
+      return sumTree(*b.getLHS()) + sumTree(*b.getRHS());
+    }
+    case Expr::Kind::Call: {
+      auto& c = llvm::cast<CallExpr>(e);
+      double s = 0;
+      for (uint32_t i = 0; i != c.getNumArgs(); ++i) {
+        s += sumTree(*c.getArg(i));
+      }
+      return s;
+    }
+    case Expr::Kind::If: {
+      auto& i = llvm::cast<IfExpr>(e);
+      return sumTree(*i.getCond()) + sumTree(*i.getThen()) +
+             sumTree(*i.getElse());
+    }
+    default:
+      return 0;
+  }
+}
+
+double sumFlat(const FlatExpr& f) {
+  double s = 0;
+  for (FlatExpr::Index i = 0; i != f.size(); ++i) {
+    if (f[i].kind == Expr::Kind::Number) {
+      s += f[i].val;
+    }
+  }
+  return s;
+}
+
+template <typename F>
+void run(const char* name, size_t nodes, F body) {
+  const int rounds = 5;
+  auto best = 1e30;
+  for (int i = 0; i < rounds; i++) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    best = std::min(best, d.count());
+  }
+  printf("%-14s %10.3f ms %8.2f ns/node\n", name, best * 1e3,
+         best * 1e9 / nodes);
+}
+
+// emits f(x y) = body and throws it away again.
+template <typename F>
+void emitFunction(F emitBody) {
+  Prototype proto(lexer::intern("f"), {lexer::intern("x"), lexer::intern("y")});
+  auto f = proto.codeGen();
+  auto bb = llvm::BasicBlock::Create(global::gContext(), "entry", f);
+  global::gBuilder().SetInsertPoint(bb);
+  global::gNamedValues().clear();
+  auto idx = 0;
+  for (auto& arg : f->args()) {
+    global::gNamedValues()[proto.getArgs()[idx++]] = &arg;
+  }
+  global::gBuilder().CreateRet(emitBody());
+  f->eraseFromParent();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int depth = argc > 1 ? std::stoi(argv[1]) : 18;
+  std::string src;
+  unsigned seed = 1;
+  makeExpr(src, depth, seed);
+
+  global::init();
+  global::initModuleAndPassManager();
+  Prototype(lexer::intern("g"), {lexer::intern("a"), lexer::intern("b")})
+      .codeGen();
+
+  Parser par(std::make_shared<const lexer::TokenBuffer>(src));
+  par.getNextToken();
+  auto tree = par.expression();
+  if (tree == nullptr) {
+    return 1;
+  }
+  auto flat = FlatExpr::flatten(*tree);
+  printf("%zu nodes, %zu bytes of source\n", flat.size(), src.size());
+
+  volatile double sink;
+  run("walk/tree", flat.size(), [&] { sink = sumTree(*tree); });
+  run("walk/flat", flat.size(), [&] { sink = sumFlat(flat); });
+  run("flatten", flat.size(), [&] { sink = FlatExpr::flatten(*tree).size(); });
+  run("codegen/tree", flat.size(),
+      [&] { emitFunction([&] { return tree->codeGen(); }); });
+  run("codegen/flat", flat.size(),
+      [&] { emitFunction([&] { return flat.codeGen(); }); });
+  (void)sink;
+  return 0;
+}
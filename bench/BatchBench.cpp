@@ -0,0 +1,59 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "batch/Batch.h"
+#include "global/Global.h"
+#include "parser/Parser.h"
+
+using namespace kaso;
+
+namespace {
+
+template <typename F>
+void run(const char* name, uint64_t n, F body) {
+  const int rounds = 5;
+  auto best = 1e30;
+  for (int i = 0; i < rounds; i++) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    best = std::min(best, d.count());
+  }
+  printf("%-8s %10.3f ms %8.2f ns/elem\n", name, best * 1e3, best * 1e9 / n);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  uint64_t n = argc > 1 ? std::stoull(argv[1]) : 1 << 22;
+
+  global::init();
+  global::initModuleAndPassManager();
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def f(x y) x * x * 0.5 + y * 3 - (x - y) * 0.25;"));
+  par.getNextToken();
+  auto fn = par.definition();
+  fn->codeGen(par.operators());
+  global::gJIT()->addModule(std::move(global::gModule()));
+  global::initModuleAndPassManager();
+  auto sym = global::gJIT()->findSymbol("f");
+  auto f = (double (*)(double, double))(intptr_t)llvm::cantFail(
+      sym.getAddress());
+  auto wrapper = batch::Batch::compile(*fn, par.operators());
+
+  std::vector<double> x(n), y(n), out(n);
+  for (uint64_t i = 0; i < n; i++) {
+    x[i] = i * 0.5;
+    y[i] = 1.0 / (i + 1);
+  }
+  const double* columns[] = {x.data(), y.data()};
+
+  run("calls", n, [&] {
+    for (uint64_t i = 0; i < n; i++) {
+      out[i] = f(x[i], y[i]);
+    }
+  });
+  run("batch", n, [&] { wrapper->run(columns, out.data(), n); });
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "global/Global.h"
+#include "interp/Interpreter.h"
+#include "parser/Parser.h"
+
+using namespace kaso;
+
+namespace {
+
+// per-expression latency from the parsed AST to the value, over n runs.
+template <typename F>
+void run(const char* name, int n, F body) {
+  auto start = std::chrono::steady_clock::now();
+  volatile double sink = 0;
+  for (int i = 0; i < n; i++) {
+    sink = body();
+  }
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  printf("%-12s %10.2f us/expr\n", name, d.count() * 1e6 / n);
+  (void)sink;
+}
+
+// what the shell did for every top-level expression before the interpreter.
+double jit(parser::Function& fn, parser::OperatorTable& ops) {
+  fn.codeGen(ops);
+  auto handle = global::gJIT()->addModule(std::move(global::gModule()));
+  global::initModuleAndPassManager();
+  auto sym = global::gJIT()->findSymbol("__anonymous_expr");
+  auto fp = (double (*)())(intptr_t)llvm::cantFail(sym.getAddress());
+  auto val = fp();
+  global::gJIT()->removeModule(handle);
+  return val;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int n = argc > 1 ? std::stoi(argv[1]) : 200;
+
+  global::init();
+  global::initModuleAndPassManager();
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def fib(x) if x < 3 then 1 else fib(x - 1) + fib(x - 2);"
+      "fib(10) * 2 + 1;"
+      "for i = 0, i < 100 in fib(i < 5);"));
+  par.getNextToken();
+  auto def = par.definition();
+  def->codeGen(par.operators());
+  global::gJIT()->addModule(std::move(global::gModule()));
+  global::initModuleAndPassManager();
+
+  const char* names[] = {"call", "loop"};
+  for (auto name : names) {
+    par.getNextToken();  // eat ';'
+    auto fn = par.topLevelExpr();
+    printf("%s:\n", name);
+    run("jit", n, [&] { return jit(*fn, par.operators()); });
+    run("interpret", n, [&] {
+      return interp::Program::compile(*fn->getBody())->run();
+    });
+  }
+  return 0;
+}
@@ -0,0 +1,73 @@
+#include <chrono>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include "lexer/Lexer.h"
+#include "lexer/Scanner.h"
+
+using namespace kaso::lexer;
+
+namespace {
+
+// shaped like our generated formula files: long identifiers, long comments.
+std::string makeSource(size_t bytes) {
+  std::string src;
+  src.reserve(bytes + 256);
+  for (size_t i = 0; src.size() < bytes; i++) {
+    src += "# coefficient table row " + std::to_string(i) +
+           " generated from the reference model, do not edit by hand\n";
+    src += "def interpolatedCoefficientForSegment" + std::to_string(i) +
+           "(normalizedInputValue previousSegmentWeight)\n";
+    src += "    normalizedInputValue * previousSegmentWeight + "
+           "interpolatedCoefficientForSegment0(normalizedInputValue 1.25);\n";
+  }
+  return src;
+}
+
+template <typename F>
+void run(const char* name, size_t bytes, F lexAll) {
+  const int rounds = 5;
+  auto best = 1e30;
+  size_t tokens = 0;
+  for (int i = 0; i < rounds; i++) {
+    auto start = std::chrono::steady_clock::now();
+    tokens = lexAll();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    best = std::min(best, d.count());
+  }
+  printf("%-8s %10zu tokens %8.3f ms %8.3f GB/s\n", name, tokens, best * 1e3,
+         bytes / best / 1e9);
+}
+
+size_t drain(Lexer& lex) {
+  size_t n = 0;
+  while (lex.getTok() != Token::Eof) {
+    n++;
+  }
+  return n;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  size_t mb = argc > 1 ? std::stoul(argv[1]) : 64;
+  auto src = makeSource(mb << 20);
+  printf("lexing %zu bytes\n", src.size());
+
+  run("stream", src.size(), [&] {
+    std::istringstream is(src);
+    Lexer lex(is);
+    return drain(lex);
+  });
+
+  for (auto isa : {scan::Isa::Scalar, scan::Isa::SSE2, scan::Isa::AVX2}) {
+    if (!scan::setIsa(isa)) {
+      continue;
+    }
+    run(scan::isaName(isa), src.size(), [&] {
+      Lexer lex(src);
+      return drain(lex);
+    });
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include "global/Global.h"
+#include "parser/Parser.h"
+
+using namespace kaso;
+
+namespace {
+
+const char* kKernels =
+    "def binary : 1 (x y) y;"
+    "def sum(n) var s in (for i = 0, i < n in s = s + i * 0.5) : s;"
+    "def nested(n) var s in"
+    "  (for i = 0, i < n, 100 in for j = 0, j < 100 in s = s + i * j) : s;"
+    "def poly(n) var s, x in"
+    "  (for i = 0, i < n in (x = i * 0.001) : s = s + x * x * x - 2 * x) : s;"
+    "def horner(n) var s, x in (for i = 0, i < n in"
+    "  (x = i * 0.001) : s = s + (((x * 0.5 + 1) * x - 2) * x + 3)) : s;"
+    "def fast hornerf(n) var s, x in (for i = 0, i < n in"
+    "  (x = i * 0.001) : s = s + (((x * 0.5 + 1) * x - 2) * x + 3)) : s;";
+
+// hornerf is horner with fast-math.
+const char* kNames[] = {"sum", "nested", "poly", "horner", "hornerf"};
+
+template <typename F>
+double best(F body) {
+  const int rounds = 5;
+  auto best = 1e30;
+  for (int i = 0; i < rounds; i++) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+    best = std::min(best, d.count());
+  }
+  return best;
+}
+
+// compiles the kernels into one module through p.
+double compile(const global::Pipeline& p) {
+  global::setPipeline(p);
+  global::initModuleAndPassManager();
+  auto start = std::chrono::steady_clock::now();
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(kKernels));
+  par.getNextToken();
+  while (par.curToken() == lexer::Token::Def) {
+    par.definition()->codeGen(par.operators());
+    par.getNextToken();
+  }
+  global::gJIT()->addModule(global::takeModule());
+  std::chrono::duration<double> d = std::chrono::steady_clock::now() - start;
+  return d.count();
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  double n = argc > 1 ? std::stod(argv[1]) : 1 << 22;
+  const char* passes = argc > 2 ? argv[2] : "";
+
+  // the four levels, then the pass list if there is one.
+  global::init();
+  for (unsigned level = 0; level <= 4; level++) {
+    global::Pipeline p;
+    auto label = "O" + std::to_string(level);
+    if (level < 4) {
+      p.level = level;
+    } else {
+      if (passes[0] == '\0') {
+        break;
+      }
+      p.passes = label = passes;
+    }
+    auto c = compile(p);
+    printf("%s: %.3f ms to compile\n", label.c_str(), c * 1e3);
+    for (auto name : kNames) {
+      auto sym = global::gJIT()->findSymbol(name);
+      auto f = (double (*)(double))(intptr_t)llvm::cantFail(sym.getAddress());
+      volatile double out;
+      auto t = best([&] { out = f(n); });
+      printf("  %-8s %10.3f ms %8.2f ns/iter\n", name, t * 1e3, t * 1e9 / n);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,50 @@
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include "parser/BatchParser.h"
+
+using namespace kaso;
+
+namespace {
+
+std::string makeSource(size_t defs) {
+  std::string src = "def binary : 1 (a b) b;\n";
+  for (size_t i = 0; i < defs; i++) {
+    auto n = std::to_string(i);
+    src += "def segment" + n + "(x y) if x < y then x * " + n +
+           " + segment0(y, x) else (y - 1.5) * (x + " + n + ") : y;\n";
+  }
+  return src;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  size_t defs = argc > 1 ? std::stoul(argv[1]) : 100000;
+  auto tokens =
+      std::make_shared<const lexer::TokenBuffer>(makeSource(defs));
+  printf("parsing %zu defs, %zu tokens\n", defs, tokens->size());
+
+  double serial = 0;
+  unsigned maxThreads = argc > 2 ? std::stoul(argv[2])
+                                 : std::thread::hardware_concurrency();
+  for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+    const int rounds = 5;
+    auto best = 1e30;
+    size_t items = 0;
+    for (int i = 0; i < rounds; i++) {
+      auto start = std::chrono::steady_clock::now();
+      items = parser::parseBatch(tokens, threads).size();
+      std::chrono::duration<double> d =
+          std::chrono::steady_clock::now() - start;
+      best = std::min(best, d.count());
+    }
+    if (threads == 1) {
+      serial = best;
+    }
+    printf("%3u threads %8zu items %10.3f ms %6.2fx\n", threads, items,
+           best * 1e3, serial / best);
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include "batch/Batch.h"
+#include <llvm/IR/IRBuilder.h>
+#include <string>
+#include "global/Global.h"
+#include "global/Optimize.h"
+
+namespace kaso {
+namespace batch {
+
+namespace {
+
+// void @<f>.batch(double** columns, double* noalias out, i64 n)
+void emitLoop(llvm::Function& f) {
+  auto& ctx = f.getContext();
+  llvm::IRBuilder<> b(ctx);
+  auto f64 = b.getDoubleTy();
+  auto i64 = b.getInt64Ty();
+  auto column = f64->getPointerTo();
+  auto type = llvm::FunctionType::get(
+      b.getVoidTy(), {column->getPointerTo(), column, i64}, false);
+  auto wrapper =
+      llvm::Function::Create(type, llvm::Function::ExternalLinkage,
+                             f.getName() + ".batch", f.getParent());
+  auto args = wrapper->arg_begin();
+  auto columns = &*args++;
+  auto out = &*args++;
+  auto n = &*args;
+  wrapper->addParamAttr(1, llvm::Attribute::NoAlias);
+
+  auto entry = llvm::BasicBlock::Create(ctx, "entry", wrapper);
+  auto loop = llvm::BasicBlock::Create(ctx, "loop", wrapper);
+  auto exit = llvm::BasicBlock::Create(ctx, "exit", wrapper);
+
+  b.SetInsertPoint(entry);
+  llvm::SmallVector<llvm::Value*, 8> starts;
+  for (unsigned k = 0; k != f.arg_size(); ++k) {
+    auto slot = b.CreateInBoundsGEP(column, columns, b.getInt64(k));
+    starts.push_back(b.CreateLoad(column, slot));
+  }
+  b.CreateCondBr(b.CreateICmpEQ(n, b.getInt64(0)), exit, loop);
+
+  b.SetInsertPoint(loop);
+  auto i = b.CreatePHI(i64, 2, "i");
+  i->addIncoming(b.getInt64(0), entry);
+  llvm::SmallVector<llvm::Value*, 8> values;
+  for (auto start : starts) {
+    values.push_back(b.CreateLoad(f64, b.CreateInBoundsGEP(f64, start, i)));
+  }
+  auto result = b.CreateCall(&f, values);
+  b.CreateStore(result, b.CreateInBoundsGEP(f64, out, i));
+  auto next = b.CreateAdd(i, b.getInt64(1));
+  i->addIncoming(next, loop);
+  b.CreateCondBr(b.CreateICmpEQ(next, n), exit, loop);
+
+  b.SetInsertPoint(exit);
+  b.CreateRetVoid();
+}
+
+}  // namespace
+
+std::unique_ptr<Batch> Batch::compile(parser::Function& fn,
+                                      parser::OperatorTable& ops) {
+  std::unique_ptr<llvm::Module> m;
+  {
+    // emit into a module of its own, leaving the one being filled alone.
+    global::SavedModule saved;
+    global::initModuleAndPassManager(false, true);
+    if (auto f = fn.codeGen(ops)) {
+      // the copy must not take the names from the compiled fn, e.g. the
+      // "<name>.uncached" body behind a memo wrapper.
+      for (auto& g : *global::gModule()) {
+        if (!g.isDeclaration()) {
+          g.setLinkage(llvm::Function::InternalLinkage);
+        }
+      }
+      emitLoop(*f);
+      m = std::move(global::gModule());
+    }
+  }
+  if (m == nullptr) {
+    return nullptr;
+  }
+
+  // the O3 pipeline, so that the loop gets vectorized, with the session's
+  // vector math library for the calls in it.
+  global::Pipeline p;
+  p.vecLib = global::pipeline().vecLib;
+  global::optimize(*m, global::gJIT()->getTargetMachine(), p);
+  auto handle = global::gJIT()->addModule(std::move(m));
+  auto sym = global::gJIT()->findSymbol(
+      lexer::symbolName(fn.getName()).str() + ".batch");
+  auto addr = llvm::cantFail(sym.getAddress());
+  return std::unique_ptr<Batch>(
+      new Batch(reinterpret_cast<BatchFn>(static_cast<intptr_t>(addr)),
+                fn.getProto().getArgs().size(), handle));
+}
+
+Batch::~Batch() { global::gJIT()->removeModule(handle_); }
+
+}  // namespace batch
+}  // namespace kaso
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include "KaleidoscopeJIT.h"
+#include "parser/Function.h"
+#include "parser/OperatorTable.h"
+
+namespace kaso {
+namespace batch {
+
+/// out[i] = f(columns[0][i], ..., columns[arity - 1][i]) for every i < n.
+using BatchFn = void (*)(const double* const* columns, double* out,
+                         uint64_t n);
+
+/// A loop over columns of arguments with a copy of f inlined into it, so
+/// that the loop vectorizer can work on it. Calls to other functions stay
+/// calls. Lives in the JIT until it is destroyed.
+class Batch {
+ public:
+  /// Emits and JIT-compiles `<name>.batch` for fn. Returns nullptr if fn
+  /// does not compile, after logging why. out must not overlap a column.
+  static std::unique_ptr<Batch> compile(parser::Function& fn,
+                                        parser::OperatorTable& ops);
+
+  ~Batch();
+
+  Batch(const Batch&) = delete;
+  Batch& operator=(const Batch&) = delete;
+
+  size_t arity() const { return arity_; }
+
+  void run(const double* const* columns, double* out, uint64_t n) const {
+    fn_(columns, out, n);
+  }
+
+ private:
+  Batch(BatchFn fn, size_t arity,
+        llvm::orc::KaleidoscopeJIT::ModuleHandleT handle)
+      : fn_(fn), arity_(arity), handle_(handle) {}
+
+  BatchFn fn_;
+  size_t arity_;
+  llvm::orc::KaleidoscopeJIT::ModuleHandleT handle_;
+};
+
+}  // namespace batch
+}  // namespace kaso
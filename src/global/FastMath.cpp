@@ -0,0 +1,94 @@
+#include "global/FastMath.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringSwitch.h>
+#include <string>
+#include "global/Global.h"
+
+namespace kaso {
+namespace global {
+
+namespace {
+unsigned gFastMath_ = 0;
+
+// the function attributes the backend reads the flags from.
+const std::pair<unsigned, const char*> kAttributes[] = {
+    {kReassoc, "unsafe-fp-math"},
+    {kNoNaNs, "no-nans-fp-math"},
+    {kNoInfs, "no-infs-fp-math"},
+    {kNoSignedZeros, "no-signed-zeros-fp-math"}};
+}  // namespace
+
+unsigned fastMathFlag(llvm::StringRef name) {
+  return llvm::StringSwitch<unsigned>(name)
+      .Case("contract", kContract)
+      .Case("reassoc",
+            kReassoc | kNoNaNs | kNoInfs | kNoSignedZeros | kAllowRecip)
+      .Case("nnan", kNoNaNs)
+      .Case("ninf", kNoInfs)
+      .Case("nsz", kNoSignedZeros)
+      .Case("arcp", kAllowRecip)
+      .Case("fast", kFastAll)
+      .Default(0);
+}
+
+bool parseFastMath(llvm::StringRef names, unsigned& flags) {
+  llvm::SmallVector<llvm::StringRef, 8> parts;
+  names.split(parts, ',', -1, false);
+  for (auto name : parts) {
+    auto flag = fastMathFlag(name.trim());
+    if (flag == 0) {
+      logError(("unknown fast-math flag " + name.trim()).str().c_str());
+      return false;
+    }
+    flags |= flag;
+  }
+  return true;
+}
+
+void setFastMath(unsigned flags) { gFastMath_ = flags; }
+
+unsigned fastMath() { return gFastMath_; }
+
+llvm::FastMathFlags toFastMathFlags(unsigned flags) {
+  llvm::FastMathFlags fmf;
+  if (flags & kReassoc) {
+    fmf.setUnsafeAlgebra();
+  }
+  if (flags & kContract) {
+    fmf.setAllowContract(true);
+  }
+  if (flags & kNoNaNs) {
+    fmf.setNoNaNs();
+  }
+  if (flags & kNoInfs) {
+    fmf.setNoInfs();
+  }
+  if (flags & kNoSignedZeros) {
+    fmf.setNoSignedZeros();
+  }
+  if (flags & kAllowRecip) {
+    fmf.setAllowReciprocal();
+  }
+  return fmf;
+}
+
+void addFastMathAttributes(llvm::Function& f, unsigned flags) {
+  for (auto& attr : kAttributes) {
+    if (flags & attr.first) {
+      f.addFnAttr(attr.second, "true");
+    }
+  }
+}
+
+void mergeFastMathAttributes(llvm::Function& caller,
+                             const llvm::Function& callee) {
+  for (auto& attr : kAttributes) {
+    if (caller.getFnAttribute(attr.second).getValueAsString() == "true" &&
+        callee.getFnAttribute(attr.second).getValueAsString() != "true") {
+      caller.addFnAttr(attr.second, "false");
+    }
+  }
+}
+
+}  // namespace global
+}  // namespace kaso
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Operator.h>
+
+namespace kaso {
+namespace global {
+
+/// Fast-math flags as a bit set. Strict IEEE semantics, 0, is the default.
+enum FastMath : unsigned {
+  kContract = 1 << 0,  // a * b + c may become an fma
+  kReassoc = 1 << 1,
+  kNoNaNs = 1 << 2,
+  kNoInfs = 1 << 3,
+  kNoSignedZeros = 1 << 4,
+  kAllowRecip = 1 << 5,
+  kFastAll = (1 << 6) - 1,
+};
+
+/// The flags named like in LLVM IR: "contract", "reassoc", "nnan", "ninf",
+/// "nsz", "arcp", or "fast" for all of them; 0 for anything else. LLVM 5
+/// can only reassociate under unsafe algebra, so "reassoc" brings nnan,
+/// ninf, nsz and arcp along.
+unsigned fastMathFlag(llvm::StringRef name);
+
+/// The flags of a comma-separated list of names, e.g. "contract,nnan".
+/// Logs the first unknown name and returns false.
+bool parseFastMath(llvm::StringRef names, unsigned& flags);
+
+/// The session's flags, which every function gets on top of its own.
+void setFastMath(unsigned flags);
+unsigned fastMath();
+
+llvm::FastMathFlags toFastMathFlags(unsigned flags);
+
+/// Tells the backend about the flags f was emitted with, for what it does
+/// per function rather than per instruction.
+void addFastMathAttributes(llvm::Function& f, unsigned flags);
+
+/// Before callee is inlined into caller: drops the attributes caller has and
+/// callee lacks, so that strict code stays strict. LLVM 5 merges only some
+/// of them in llvm::AttributeFuncs::mergeAttributesForInlining().
+void mergeFastMathAttributes(llvm::Function& caller,
+                             const llvm::Function& callee);
+
+}  // namespace global
+}  // namespace kaso
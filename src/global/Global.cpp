@@ -1,7 +1,12 @@
 #include "Global.h"
+#include <llvm/ADT/SmallPtrSet.h>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Transforms/Scalar.h>
 #include <llvm/Transforms/Scalar/GVN.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/ValueMapper.h>
+#include "global/Target.h"
 
 namespace kaso {
 
@@ -9,18 +14,72 @@ namespace {
 std::unique_ptr<llvm::LLVMContext> gContext_;
 std::unique_ptr<llvm::IRBuilder<>> gBuilder_;
 std::unique_ptr<llvm::Module> gModule_;
-std::map<std::string, llvm::Value*> gNamedValues_;
+llvm::DenseMap<lexer::Symbol, llvm::Value*> gNamedValues_;
 std::unique_ptr<llvm::legacy::FunctionPassManager> gFPM_;
 std::unique_ptr<llvm::orc::KaleidoscopeJIT> gJIT_;
-std::map<std::string, std::unique_ptr<parser::Prototype>> gFuncProtos_;
+llvm::DenseMap<lexer::Symbol, std::unique_ptr<parser::Prototype>>
+    gFuncProtos_;
+/// small definitions compiled so far, see storeBody().
+std::unique_ptr<llvm::Module> gBodies_;
+bool gImport_ = false;
+kaso::global::Pipeline gPipeline_;
+bool gOptimize_ = false;
+
+const size_t kMaxInlineSize = 40;
+
+// Copies the body of from into the declaration to, which may live in
+// another module: the functions it calls become declarations there. Fails
+// if one of them is already declared there with another type.
+bool cloneBody(const llvm::Function& from, llvm::Function& to) {
+  llvm::ValueToValueMapTy vmap;
+  auto dst = to.getParent();
+  vmap[&from] = &to;
+  for (auto& bb : from) {
+    for (auto& inst : bb) {
+      for (auto& op : inst.operands()) {
+        auto g = llvm::dyn_cast<llvm::Function>(op);
+        if (g == nullptr || vmap.count(g)) {
+          continue;
+        }
+        auto d = dst->getFunction(g->getName());
+        if (d == nullptr) {
+          d = llvm::Function::Create(g->getFunctionType(),
+                                     llvm::Function::ExternalLinkage,
+                                     g->getName(), dst);
+        } else if (d->getFunctionType() != g->getFunctionType()) {
+          return false;
+        }
+        vmap[g] = d;
+      }
+    }
+  }
+  auto arg = to.arg_begin();
+  for (auto& a : from.args()) {
+    vmap[&a] = &*arg++;
+  }
+  llvm::SmallVector<llvm::ReturnInst*, 4> returns;
+  llvm::CloneFunctionInto(&to, &from, vmap, true, returns);
+  return true;
+}
 
-std::map<lexer::Token, int> binOpPrec = {{lexer::Token::OpLess, 10},
-                                         {lexer::Token::OpAdd, 20},
-                                         {lexer::Token::OpSub, 20},
-                                         {lexer::Token::OpMul, 40}};
+// Empties the stored bodies that call body, the version of a definition
+// being replaced. Their compiled originals keep calling it, but an import of
+// them would link to the new one.
+void dropCallers(llvm::Function& body) {
+  llvm::SmallPtrSet<llvm::Function*, 8> callers;
+  for (auto user : body.users()) {
+    if (auto inst = llvm::dyn_cast<llvm::Instruction>(user)) {
+      callers.insert(inst->getFunction());
+    }
+  }
+  callers.erase(&body);
+  for (auto caller : callers) {
+    caller->deleteBody();
+  }
+}
 }  // namespace
 
-std::unique_ptr<parser::Expr> logError(const char* s) {
+parser::Expr* logError(const char* s) {
   fprintf(stderr, "LogError: %s\n", s);
   return nullptr;
 }
@@ -42,16 +101,36 @@ void init() {
   llvm::InitializeNativeTargetAsmPrinter();
   llvm::InitializeNativeTargetAsmParser();
 
+  // a session started before goes first, its IR lives in the old context.
+  gFPM_.reset();
+  gModule_.reset();
+  gBodies_.reset();
+  gJIT_.reset();
+  gNamedValues_.clear();
+  gFuncProtos_.clear();
+
   gContext_ = std::make_unique<llvm::LLVMContext>();
   gBuilder_ = std::make_unique<llvm::IRBuilder<>>(*gContext_);
-  gJIT_ = std::make_unique<llvm::orc::KaleidoscopeJIT>();
+  gJIT_ = std::make_unique<llvm::orc::KaleidoscopeJIT>(createTargetMachine());
+  gBodies_ = std::make_unique<llvm::Module>("gBodies", *gContext_);
 }
 
-void initModuleAndPassManager() {
+void initModuleAndPassManager(bool optimize, bool importBodies) {
   gModule_ = std::make_unique<llvm::Module>("gModule", *gContext_);
   gModule_->setDataLayout(gJIT_->getTargetMachine().createDataLayout());
+  gImport_ = optimize || importBodies;
+  gOptimize_ = optimize;
 
+  // locals are emitted as allocas, so even unoptimized code promotes them,
+  // and self tail calls become loops however deep the recursion goes.
   gFPM_ = std::make_unique<llvm::legacy::FunctionPassManager>(gModule_.get());
+  gFPM_->add(llvm::createPromoteMemoryToRegisterPass());
+  gFPM_->add(llvm::createTailCallEliminationPass());
+  if (!optimize || gPipeline_.level == 0 || !gPipeline_.passes.empty()) {
+    gFPM_->doInitialization();
+    return;
+  }
+  gFPM_->add(llvm::createSROAPass());
   gFPM_->add(llvm::createInstructionCombiningPass());
   gFPM_->add(llvm::createReassociatePass());
   gFPM_->add(llvm::createGVNPass());
@@ -59,25 +138,50 @@ void initModuleAndPassManager() {
   gFPM_->doInitialization();
 }
 
+std::unique_ptr<llvm::Module> takeModule() {
+  if (gOptimize_ && (gPipeline_.level >= 2 || !gPipeline_.passes.empty())) {
+    optimize(*gModule_, gJIT_->getTargetMachine(), gPipeline_);
+  }
+  return std::move(gModule_);
+}
+
+SavedModule::SavedModule()
+    : module_(std::move(gModule_)),
+      fpm_(std::move(gFPM_)),
+      optimize_(gOptimize_),
+      import_(gImport_) {}
+
+SavedModule::~SavedModule() {
+  gModule_ = std::move(module_);
+  gFPM_ = std::move(fpm_);
+  gOptimize_ = optimize_;
+  gImport_ = import_;
+}
+
+void setPipeline(const Pipeline& p) { gPipeline_ = p; }
+
+const Pipeline& pipeline() { return gPipeline_; }
+
 llvm::LLVMContext& gContext() { return *gContext_; }
 
 llvm::IRBuilder<>& gBuilder() { return *gBuilder_; }
 
 std::unique_ptr<llvm::Module>& gModule() { return gModule_; }
 
-std::map<std::string, llvm::Value*>& gNamedValues() { return gNamedValues_; }
+llvm::DenseMap<lexer::Symbol, llvm::Value*>& gNamedValues() {
+  return gNamedValues_;
+}
 
 std::unique_ptr<llvm::legacy::FunctionPassManager>& gFPM() { return gFPM_; }
 
 std::unique_ptr<llvm::orc::KaleidoscopeJIT>& gJIT() { return gJIT_; };
 
-void storeProto(const std::string& name,
-                std::unique_ptr<parser::Prototype> proto) {
+void storeProto(lexer::Symbol name, std::unique_ptr<parser::Prototype> proto) {
   gFuncProtos_[name] = std::move(proto);
 }
 
-llvm::Function* getFunction(const std::string name) {
-  auto f = gModule_->getFunction(name);
+llvm::Function* getFunction(lexer::Symbol name) {
+  auto f = gModule_->getFunction(lexer::symbolName(name));
   if (f != nullptr) {
     return f;
   }
@@ -90,20 +194,51 @@ llvm::Function* getFunction(const std::string name) {
   return nullptr;
 }
 
-int getBinOpTokPrecedence(lexer::Token tok) {
-  auto it = binOpPrec.find(tok);
-  if (it == binOpPrec.end() || it->second <= 0) {
-    return -1;
-  } else {
-    return it->second;
+llvm::Function* getCallee(lexer::Symbol name) {
+  auto f = getFunction(name);
+  if (f == nullptr || !gImport_ || !f->isDeclaration()) {
+    return f;
   }
+  auto body = gBodies_->getFunction(lexer::symbolName(name));
+  if (body != nullptr && !body->isDeclaration() &&
+      body->getFunctionType() == f->getFunctionType() && cloneBody(*body, *f)) {
+    f->setLinkage(llvm::Function::AvailableExternallyLinkage);
+  }
+  return f;
 }
 
-void setBinOpTokPrecedence(lexer::Token tok, int prec) {
-  binOpPrec[tok] = prec;
+void storeBody(llvm::Function& f) {
+  auto body = gBodies_->getFunction(f.getName());
+  if (body != nullptr) {
+    dropCallers(*body);
+    body->deleteBody();
+    if (body->getFunctionType() != f.getFunctionType()) {
+      body->setName("");
+      body = nullptr;
+    }
+  }
+
+  size_t size = 0;
+  for (auto& bb : f) {
+    size += bb.size();
+  }
+  if (size > kMaxInlineSize) {
+    return;
+  }
+  if (body == nullptr) {
+    body = llvm::Function::Create(f.getFunctionType(),
+                                  llvm::Function::ExternalLinkage, f.getName(),
+                                  gBodies_.get());
+  }
+  if (!cloneBody(f, *body)) {
+    body->deleteBody();
+  }
 }
 
-void eraseBinOpTok(lexer::Token tok) { binOpPrec.erase(tok); }
+const parser::Prototype* getProto(lexer::Symbol name) {
+  auto fi = gFuncProtos_.find(name);
+  return fi != gFuncProtos_.end() ? fi->second.get() : nullptr;
+}
 
 }  // namespace global
 
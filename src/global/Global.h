@@ -1,19 +1,57 @@
 #pragma once
 
+#include <llvm/ADT/DenseMap.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
 #include "KaleidoscopeJIT.h"
+#include "global/Optimize.h"
 #include "parser/Expr.h"
 #include "parser/Function.h"
 
 namespace kaso {
 namespace global {
 
+/// Starts a session with a fresh context and JIT. Whatever an earlier one
+/// compiled is dropped.
 void init();
 
-void initModuleAndPassManager();
+/// Starts a new module. Without optimize functions only get their locals
+/// promoted to registers and their self tail calls turned into loops, to be
+/// optimized later if at all. Optimized modules, and those built with
+/// importBodies for an optimizer that runs later, see the IR of small
+/// definitions through getCallee(). From O1 on, an optimized module's
+/// functions also get the scalar cleanup passes as they are emitted.
+void initModuleAndPassManager(bool optimize = true, bool importBodies = false);
+
+/// Hands the current module over, after running the module-level part of
+/// the pipeline (O2 and up, or a pass list) if it was started with
+/// optimize.
+std::unique_ptr<llvm::Module> takeModule();
+
+/// Sets the module being filled aside, with its pass manager and the options
+/// it was started with, and puts them back when it goes out of scope. In
+/// between another module can be started and taken.
+class SavedModule {
+ public:
+  SavedModule();
+  ~SavedModule();
+
+  SavedModule(const SavedModule&) = delete;
+  SavedModule& operator=(const SavedModule&) = delete;
+
+ private:
+  std::unique_ptr<llvm::Module> module_;
+  std::unique_ptr<llvm::legacy::FunctionPassManager> fpm_;
+  bool optimize_;
+  bool import_;
+};
+
+/// The pipeline of optimized modules and of the O3 tier, O3 by default.
+/// Applies to modules started after the call.
+void setPipeline(const Pipeline& p);
+const Pipeline& pipeline();
 
 llvm::LLVMContext& gContext();
 
@@ -21,24 +59,36 @@ llvm::IRBuilder<>& gBuilder();
 
 std::unique_ptr<llvm::Module>& gModule();
 
-std::map<std::string, llvm::Value*>& gNamedValues();
+llvm::DenseMap<lexer::Symbol, llvm::Value*>& gNamedValues();
 
 std::unique_ptr<llvm::legacy::FunctionPassManager>& gFPM();
 
 std::unique_ptr<llvm::orc::KaleidoscopeJIT>& gJIT();
 
-void storeProto(const std::string& name,
-                std::unique_ptr<parser::Prototype> proto);
+void storeProto(lexer::Symbol name, std::unique_ptr<parser::Prototype> proto);
 
-llvm::Function* getFunction(std::string name);
+llvm::Function* getFunction(lexer::Symbol name);
 
-int getBinOpTokPrecedence(lexer::Token tok);
-void setBinOpTokPrecedence(lexer::Token tok, int prec);
-void eraseBinOpTok(lexer::Token tok);
+/// getFunction() for a call site. If the module imports bodies and name is
+/// a small definition, the declaration gets its stored IR as
+/// available_externally, so the inliner can use it while the JIT still links
+/// against the compiled original.
+llvm::Function* getCallee(lexer::Symbol name);
+
+/// Keeps the IR of f, a definition just compiled, for later modules to
+/// import if it is small enough to inline. That is f after the function
+/// passes and before the module pipeline, so a definition compiled for the
+/// baseline tier leaves its baseline IR. It replaces the version stored
+/// under the same name, and the stored bodies that call that one are
+/// dropped.
+void storeBody(llvm::Function& f);
+
+/// Prototype of a function defined or declared so far, or nullptr.
+const parser::Prototype* getProto(lexer::Symbol name);
 
 }  // namespace global
 
-std::unique_ptr<parser::Expr> logError(const char* s);
+parser::Expr* logError(const char* s);
 
 std::unique_ptr<parser::Prototype> logErrorP(const char* s);
 
@@ -0,0 +1,22 @@
+#include "global/JitModules.h"
+#include <cassert>
+
+namespace kaso {
+namespace global {
+
+size_t JitModules::add(Handle handle, size_t definitions) {
+  modules_.push_back({handle, definitions});
+  return modules_.size() - 1;
+}
+
+llvm::Optional<JitModules::Handle> JitModules::release(size_t index) {
+  auto& m = modules_[index];
+  assert(m.live != 0 && "module released too often");
+  if (--m.live != 0) {
+    return llvm::None;
+  }
+  return m.handle;
+}
+
+}  // namespace global
+}  // namespace kaso
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <llvm/ADT/Optional.h>
+#include <vector>
+#include "KaleidoscopeJIT.h"
+
+namespace kaso {
+namespace global {
+
+/// The modules handed to the JIT with definitions in them, each with a
+/// count of the definitions in it that are still current. A module can be
+/// removed once that count drops to zero.
+class JitModules {
+ public:
+  using Handle = llvm::orc::KaleidoscopeJIT::ModuleHandleT;
+
+  /// Records a module holding definitions definitions. Returns its index.
+  size_t add(Handle handle, size_t definitions);
+
+  /// A definition in the module at index was replaced. Returns the handle
+  /// of the module if that was its last current one.
+  llvm::Optional<Handle> release(size_t index);
+
+  /// Definitions in the module at index not replaced since.
+  size_t live(size_t index) const { return modules_[index].live; }
+
+ private:
+  struct Module {
+    Handle handle;
+    size_t live;
+  };
+
+  std::vector<Module> modules_;
+};
+
+}  // namespace global
+}  // namespace kaso
@@ -0,0 +1,67 @@
+#include "global/MathLib.h"
+#include "global/Global.h"
+
+namespace kaso {
+namespace global {
+
+namespace {
+
+struct MathFunction {
+  const char* name;
+  size_t numArgs;
+  llvm::Intrinsic::ID id;
+};
+
+// all of them are overloaded on the floating-point type.
+const MathFunction kMathFunctions[] = {
+    {"sqrt", 1, llvm::Intrinsic::sqrt},
+    {"sin", 1, llvm::Intrinsic::sin},
+    {"cos", 1, llvm::Intrinsic::cos},
+    {"exp", 1, llvm::Intrinsic::exp},
+    {"exp2", 1, llvm::Intrinsic::exp2},
+    {"log", 1, llvm::Intrinsic::log},
+    {"log2", 1, llvm::Intrinsic::log2},
+    {"log10", 1, llvm::Intrinsic::log10},
+    {"fabs", 1, llvm::Intrinsic::fabs},
+    {"floor", 1, llvm::Intrinsic::floor},
+    {"ceil", 1, llvm::Intrinsic::ceil},
+    {"trunc", 1, llvm::Intrinsic::trunc},
+    {"rint", 1, llvm::Intrinsic::rint},
+    {"nearbyint", 1, llvm::Intrinsic::nearbyint},
+    {"round", 1, llvm::Intrinsic::round},
+    {"pow", 2, llvm::Intrinsic::pow},
+    {"copysign", 2, llvm::Intrinsic::copysign},
+    {"fmin", 2, llvm::Intrinsic::minnum},
+    {"fmax", 2, llvm::Intrinsic::maxnum},
+    {"fma", 3, llvm::Intrinsic::fma},
+};
+
+}  // namespace
+
+llvm::Intrinsic::ID mathIntrinsic(llvm::StringRef name, size_t numArgs) {
+  for (auto& f : kMathFunctions) {
+    if (name == f.name && numArgs == f.numArgs) {
+      return f.id;
+    }
+  }
+  return llvm::Intrinsic::not_intrinsic;
+}
+
+bool parseVecLib(llvm::StringRef name,
+                 llvm::TargetLibraryInfoImpl::VectorLibrary& lib) {
+  using TLI = llvm::TargetLibraryInfoImpl;
+  if (name.empty()) {
+    lib = TLI::NoLibrary;
+  } else if (name == "Accelerate") {
+    lib = TLI::Accelerate;
+  } else if (name == "SVML") {
+    lib = TLI::SVML;
+  } else {
+    logError(("unknown vector library " + name).str().c_str());
+    return false;
+  }
+  return true;
+}
+
+}  // namespace global
+}  // namespace kaso
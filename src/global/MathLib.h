@@ -0,0 +1,25 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/IR/Intrinsics.h>
+
+namespace kaso {
+namespace global {
+
+/// The intrinsic an 'extern' of the C math library lowers to, e.g.
+/// llvm.sin.f64 for sin(x), or not_intrinsic if name with numArgs arguments
+/// is none of sqrt, sin, cos, exp, exp2, log, log2, log10, fabs, floor,
+/// ceil, trunc, rint, nearbyint, round, pow, copysign, fmin, fmax and fma.
+/// Unlike a call to an unknown function an intrinsic has no side effects,
+/// so the optimizer can fold, hoist and vectorize it; the backend turns it
+/// into an instruction or a call to the same library function.
+llvm::Intrinsic::ID mathIntrinsic(llvm::StringRef name, size_t numArgs);
+
+/// The vector math library named "Accelerate" or "SVML", or NoLibrary for
+/// "". Logs any other name and returns false.
+bool parseVecLib(llvm::StringRef name,
+                 llvm::TargetLibraryInfoImpl::VectorLibrary& lib);
+
+}  // namespace global
+}  // namespace kaso
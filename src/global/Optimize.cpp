@@ -0,0 +1,103 @@
+#include "global/Optimize.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Analysis/TargetLibraryInfo.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/InitializePasses.h>
+#include <llvm/PassRegistry.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include "global/Global.h"
+#include "global/MathLib.h"
+
+namespace kaso {
+namespace global {
+
+namespace {
+
+// the pass registry only knows the passes that registered themselves.
+llvm::PassRegistry& registry() {
+  static llvm::PassRegistry* r = [] {
+    auto r = llvm::PassRegistry::getPassRegistry();
+    llvm::initializeCore(*r);
+    llvm::initializeAnalysis(*r);
+    llvm::initializeTransformUtils(*r);
+    llvm::initializeScalarOpts(*r);
+    llvm::initializeInstCombine(*r);
+    llvm::initializeIPO(*r);
+    llvm::initializeVectorization(*r);
+    return r;
+  }();
+  return *r;
+}
+
+llvm::SmallVector<llvm::StringRef, 8> passNames(llvm::StringRef passes) {
+  llvm::SmallVector<llvm::StringRef, 8> names;
+  passes.split(names, ',', -1, false);
+  for (auto& name : names) {
+    name = name.trim();
+  }
+  return names;
+}
+
+}  // namespace
+
+void optimize(llvm::Module& m, llvm::TargetMachine& tm, const Pipeline& p) {
+  llvm::TargetLibraryInfoImpl tli(tm.getTargetTriple());
+  auto vecLib = llvm::TargetLibraryInfoImpl::NoLibrary;
+  if (parseVecLib(p.vecLib, vecLib)) {
+    tli.addVectorizableFunctionsFromVecLib(vecLib);
+  }
+
+  if (!p.passes.empty()) {
+    llvm::legacy::PassManager mpm;
+    mpm.add(new llvm::TargetLibraryInfoWrapperPass(tli));
+    mpm.add(
+        llvm::createTargetTransformInfoWrapperPass(tm.getTargetIRAnalysis()));
+    for (auto name : passNames(p.passes)) {
+      if (auto info = registry().getPassInfo(name)) {
+        mpm.add(info->createPass());
+      }
+    }
+    mpm.run(m);
+    return;
+  }
+
+  llvm::PassManagerBuilder builder;
+  builder.OptLevel = p.level;
+  if (p.level >= 2) {
+    builder.Inliner = llvm::createFunctionInliningPass(p.level, 0, false);
+    builder.LoopVectorize = true;
+    builder.SLPVectorize = true;
+  }
+  // the builder deletes it.
+  builder.LibraryInfo = new llvm::TargetLibraryInfoImpl(tli);
+  tm.adjustPassManager(builder);
+
+  llvm::legacy::FunctionPassManager fpm(&m);
+  fpm.add(llvm::createTargetTransformInfoWrapperPass(tm.getTargetIRAnalysis()));
+  builder.populateFunctionPassManager(fpm);
+  fpm.doInitialization();
+  for (auto& f : m) {
+    fpm.run(f);
+  }
+  fpm.doFinalization();
+
+  llvm::legacy::PassManager mpm;
+  mpm.add(llvm::createTargetTransformInfoWrapperPass(tm.getTargetIRAnalysis()));
+  builder.populateModulePassManager(mpm);
+  mpm.run(m);
+}
+
+bool checkPasses(llvm::StringRef passes) {
+  for (auto name : passNames(passes)) {
+    if (registry().getPassInfo(name) == nullptr) {
+      logError(("unknown pass " + name).str().c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace global
+}  // namespace kaso
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+#include <string>
+
+namespace kaso {
+namespace global {
+
+/// An optimization pipeline: an -O level, or a comma-separated list of
+/// LLVM pass names like "licm,loop-unroll,gvn" that replaces it. vecLib
+/// names a vector math library, see parseVecLib(), whose functions the
+/// vectorizers may call for the math intrinsics in a loop. The JIT looks
+/// them up in the process, so the library has to be linked in or preloaded.
+struct Pipeline {
+  unsigned level = 3;
+  std::string passes;
+  std::string vecLib;
+};
+
+/// Runs p over m, tuned for tm. A level goes through PassManagerBuilder,
+/// with the inliner and the loop and SLP vectorizers from O2 on. Safe to
+/// call on any thread for a module in a context of its own.
+void optimize(llvm::Module& m, llvm::TargetMachine& tm,
+              const Pipeline& p = Pipeline());
+
+/// Whether every name in passes is a known pass. Logs the first that is
+/// not.
+bool checkPasses(llvm::StringRef passes);
+
+}  // namespace global
+}  // namespace kaso
@@ -0,0 +1,121 @@
+#include "global/Target.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <algorithm>
+#include "global/Global.h"
+
+namespace kaso {
+namespace global {
+
+namespace {
+
+Target gTarget_;
+
+std::vector<std::string> splitFeatures(llvm::StringRef features) {
+  llvm::SmallVector<llvm::StringRef, 32> parts;
+  features.split(parts, ',', -1, false);
+  std::vector<std::string> attrs;
+  for (auto part : parts) {
+    attrs.push_back(part.trim().str());
+  }
+  return attrs;
+}
+
+}  // namespace
+
+Target hostTarget() {
+  Target t;
+  t.cpu = llvm::sys::getHostCPUName().str();
+  llvm::StringMap<bool> features;
+  if (!llvm::sys::getHostCPUFeatures(features)) {
+    return t;
+  }
+  std::vector<std::string> attrs;
+  for (auto& f : features) {
+    attrs.push_back((f.second ? "+" : "-") + f.first().str());
+  }
+  // StringMap order is arbitrary.
+  std::sort(attrs.begin(), attrs.end());
+  for (auto& attr : attrs) {
+    t.features += t.features.empty() ? attr : "," + attr;
+  }
+  return t;
+}
+
+void setTarget(const Target& t) { gTarget_ = t; }
+
+Target target() {
+  if (!gTarget_.cpu.empty()) {
+    return gTarget_;
+  }
+  auto t = hostTarget();
+  if (!gTarget_.features.empty()) {
+    t.features += t.features.empty() ? "" : ",";
+    t.features += gTarget_.features;
+  }
+  return t;
+}
+
+std::unique_ptr<llvm::TargetMachine> createTargetMachine() {
+  auto t = target();
+  return std::unique_ptr<llvm::TargetMachine>(
+      llvm::EngineBuilder()
+          .setMCPU(t.cpu)
+          .setMAttrs(splitFeatures(t.features))
+          .selectTarget());
+}
+
+bool checkTarget() {
+  // may run before init().
+  llvm::InitializeNativeTarget();
+  auto attrs = splitFeatures(gTarget_.features);
+  for (auto& attr : attrs) {
+    if (attr[0] != '+' && attr[0] != '-') {
+      logError(("feature " + attr + " needs a + or -").c_str());
+      return false;
+    }
+  }
+  // the features are checked below, one at a time.
+  auto t = target();
+  std::unique_ptr<llvm::TargetMachine> tm(
+      llvm::EngineBuilder().setMCPU(t.cpu).selectTarget());
+  if (tm == nullptr || !tm->getMCSubtargetInfo()->isCPUStringValid(t.cpu)) {
+    logError(("unknown CPU " + t.cpu).c_str());
+    return false;
+  }
+  // turning on a feature the target knows sets at least its own bit.
+  std::unique_ptr<llvm::MCSubtargetInfo> sti(
+      tm->getTarget().createMCSubtargetInfo(tm->getTargetTriple().str(),
+                                            t.cpu, ""));
+  for (auto& attr : attrs) {
+    sti->setFeatureBits(llvm::FeatureBitset());
+    if (sti->ApplyFeatureFlag("+" + attr.substr(1)).none()) {
+      logError(("unknown feature " + attr.substr(1)).c_str());
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> activeFeatures(llvm::StringRef features) {
+  llvm::StringMap<bool> on;
+  for (auto& attr : splitFeatures(features)) {
+    on[llvm::StringRef(attr).drop_front()] = attr[0] == '+';
+  }
+  std::vector<std::string> active;
+  for (auto& f : on) {
+    if (f.second) {
+      active.push_back(f.first().str());
+    }
+  }
+  std::sort(active.begin(), active.end());
+  return active;
+}
+
+}  // namespace global
+}  // namespace kaso
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Target/TargetMachine.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace kaso {
+namespace global {
+
+/// The CPU code is compiled for and a comma-separated list of features to
+/// turn on or off on top of it, like "+avx2,-avx512f". An empty cpu is the
+/// host's, with every feature the host reports.
+struct Target {
+  std::string cpu;
+  std::string features;
+};
+
+/// The host CPU and its features, all of them listed.
+Target hostTarget();
+
+/// Applies to target machines created after the call, the JIT's included
+/// when it comes before init().
+void setTarget(const Target& t);
+
+/// The target set with setTarget(), with the host filled in.
+Target target();
+
+/// A TargetMachine for target(), the one the JIT and the tiering worker
+/// compile with.
+std::unique_ptr<llvm::TargetMachine> createTargetMachine();
+
+/// Whether target() names a CPU this LLVM knows, and every feature given
+/// to setTarget() has a sign and is one of the target's. Logs the first
+/// problem.
+bool checkTarget();
+
+/// The features a list like Target::features leaves on, sorted, the last
+/// entry for a feature winning.
+std::vector<std::string> activeFeatures(llvm::StringRef features);
+
+}  // namespace global
+}  // namespace kaso
@@ -19,6 +19,8 @@
 #include <string>
 #include <vector>
 #include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
@@ -30,6 +32,7 @@
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Mangler.h"
+#include "llvm/Object/ObjectFile.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Target/TargetMachine.h"
@@ -43,17 +46,29 @@ class KaleidoscopeJIT {
   using CompileLayerT = IRCompileLayer<ObjLayerT, SimpleCompiler>;
   using ModuleHandleT = CompileLayerT::ModuleHandleT;
 
-  KaleidoscopeJIT()
-      : TM(EngineBuilder().selectTarget()),
-        DL(TM->createDataLayout()),
+  KaleidoscopeJIT() : KaleidoscopeJIT(std::unique_ptr<TargetMachine>(
+                          EngineBuilder().selectTarget())) {}
+
+  /// Compiles for TM, e.g. one set up for the host CPU and its features.
+  explicit KaleidoscopeJIT(std::unique_ptr<TargetMachine> TM)
+      : TM(std::move(TM)),
+        DL(this->TM->createDataLayout()),
+        GlobalPrefix(DL.getGlobalPrefix()),
         ObjectLayer([]() { return std::make_shared<SectionMemoryManager>(); }),
-        CompileLayer(ObjectLayer, SimpleCompiler(*TM)) {
+        CompileLayer(ObjectLayer, SimpleCompiler(*this->TM)) {
     llvm::sys::DynamicLibrary::LoadLibraryPermanently(nullptr);
   }
 
   TargetMachine &getTargetMachine() { return *TM; }
 
   ModuleHandleT addModule(std::unique_ptr<Module> M) {
+    // The module is gone once it is compiled, so note what it defines first.
+    std::vector<std::string> Names;
+    for (auto &GV : M->global_values())
+      if (!GV.isDeclaration() && !GV.hasLocalLinkage() &&
+          !GV.hasAvailableExternallyLinkage())
+        Names.push_back(mangle(GV.getName()));
+
     // We need a memory manager to allocate memory and resolve symbols for this
     // new module. Create one that resolves symbols by looking back into the
     // JIT.
@@ -66,21 +81,76 @@ class KaleidoscopeJIT {
     auto H =
         cantFail(CompileLayer.addModule(std::move(M), std::move(Resolver)));
 
-    ModuleHandles.push_back(H);
+    addSymbols(H, std::move(Names));
+    return H;
+  }
+
+  /// Links an object compiled elsewhere, e.g. on another thread with its own
+  /// TargetMachine. It is removed again with removeModule.
+  ModuleHandleT addObject(object::OwningBinary<object::ObjectFile> Obj) {
+    // Object symbol names are mangled already.
+    std::vector<std::string> Names;
+    for (auto &Sym : Obj.getBinary()->symbols()) {
+      auto Flags = Sym.getFlags();
+      if (!(Flags & object::BasicSymbolRef::SF_Global) ||
+          (Flags & object::BasicSymbolRef::SF_Undefined))
+        continue;
+      if (auto Name = Sym.getName())
+        Names.push_back(Name->str());
+      else
+        consumeError(Name.takeError());
+    }
+
+    auto Resolver = createLambdaResolver(
+        [&](const std::string &Name) {
+          if (auto Sym = findMangledSymbol(Name)) return Sym;
+          return JITSymbol(nullptr);
+        },
+        [](const std::string &S) { return nullptr; });
+    auto H = cantFail(ObjectLayer.addObject(
+        std::make_shared<object::OwningBinary<object::ObjectFile>>(
+            std::move(Obj)),
+        std::move(Resolver)));
+
+    addSymbols(H, std::move(Names));
     return H;
   }
 
   void removeModule(ModuleHandleT H) {
-    ModuleHandles.erase(find(ModuleHandles, H));
+    // Usually the module added last, like a top-level expression.
+    auto I = std::find_if(Modules.rbegin(), Modules.rend(),
+                          [&](const ModuleSymbols &M) { return M.H == H; });
+    for (auto &Name : I->Names) {
+      auto Entry = SymbolTable.find(Name);
+      auto &Handles = Entry->second;
+      Handles.erase(find(Handles, H));
+      if (Handles.empty())
+        SymbolTable.erase(Entry);
+    }
+    Modules.erase(std::next(I).base());
     cantFail(CompileLayer.removeModule(H));
   }
 
-  JITSymbol findSymbol(const std::string Name) {
+  JITSymbol findSymbol(const std::string &Name) {
+    // Most object formats have no prefix, and the name is used as is.
+    if (!GlobalPrefix)
+      return findMangledSymbol(Name);
     return findMangledSymbol(mangle(Name));
   }
 
  private:
-  std::string mangle(const std::string &Name) {
+  struct ModuleSymbols {
+    ModuleHandleT H;
+    std::vector<std::string> Names;
+  };
+
+  void addSymbols(ModuleHandleT H, std::vector<std::string> Names) {
+    for (auto &Name : Names)
+      SymbolTable[Name].push_back(H);
+    Modules.push_back({H, std::move(Names)});
+  }
+
+  std::string mangle(StringRef Name) {
     std::string MangledName;
     {
       raw_string_ostream MangledNameStream(MangledName);
@@ -103,16 +173,26 @@ class KaleidoscopeJIT {
     const bool ExportedSymbolsOnly = true;
 #endif
 
-    // Search modules in reverse order: from last added to first added.
-    // This is the opposite of the usual search order for dlsym, but makes more
-    // sense in a REPL where we want to bind to the newest available definition.
-    for (auto H : make_range(ModuleHandles.rbegin(), ModuleHandles.rend()))
-      if (auto Sym = CompileLayer.findSymbolIn(H, Name, ExportedSymbolsOnly))
-        return Sym;
+    // Search the modules defining Name in reverse order: from last added to
+    // first added. This is the opposite of the usual search order for dlsym,
+    // but makes more sense in a REPL where we want to bind to the newest
+    // available definition. Only the modules that define Name are searched,
+    // so the cost does not grow with the session.
+    auto Entry = SymbolTable.find(Name);
+    if (Entry != SymbolTable.end())
+      for (auto H : make_range(Entry->second.rbegin(), Entry->second.rend()))
+        if (auto Sym = CompileLayer.findSymbolIn(H, Name, ExportedSymbolsOnly))
+          return Sym;
 
     // If we can't find the symbol in the JIT, try looking in the host process.
-    if (auto SymAddr = RTDyldMemoryManager::getSymbolAddressInProcess(Name))
+    // The process does not change, so what is found there is kept.
+    auto Cached = ProcessSymbols.find(Name);
+    if (Cached != ProcessSymbols.end())
+      return JITSymbol(Cached->second, JITSymbolFlags::Exported);
+    if (auto SymAddr = RTDyldMemoryManager::getSymbolAddressInProcess(Name)) {
+      ProcessSymbols[Name] = SymAddr;
       return JITSymbol(SymAddr, JITSymbolFlags::Exported);
+    }
 
 #ifdef LLVM_ON_WIN32
     // For Windows retry without "_" at beginning, as RTDyldMemoryManager uses
@@ -129,9 +209,15 @@ class KaleidoscopeJIT {
 
   std::unique_ptr<TargetMachine> TM;
   const DataLayout DL;
+  const char GlobalPrefix;
   ObjLayerT ObjectLayer;
   CompileLayerT CompileLayer;
-  std::vector<ModuleHandleT> ModuleHandles;
+  /// The modules in the order they were added, with what each defines.
+  std::vector<ModuleSymbols> Modules;
+  /// The modules defining each mangled name, newest last.
+  StringMap<SmallVector<ModuleHandleT, 1>> SymbolTable;
+  /// Addresses of the host process symbols looked up so far.
+  StringMap<JITTargetAddress> ProcessSymbols;
 };
 
 }  // end namespace orc
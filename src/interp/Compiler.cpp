@@ -0,0 +1,294 @@
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/Optional.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Casting.h>
+#include <algorithm>
+#include "global/Global.h"
+#include "interp/Interpreter.h"
+#include "parser/Builtin.h"
+
+namespace kaso {
+namespace interp {
+
+/// Evaluates each expression into a given register and uses the ones above
+/// it as scratch, so live values always sit below the one being computed.
+class Compiler {
+ public:
+  explicit Compiler(Program& p) : p_(p) {}
+
+  bool emit(const parser::Expr& e, uint32_t dst);
+
+ private:
+  /// The register a name was bound to before, if any.
+  using Binding = llvm::Optional<uint32_t>;
+
+  bool emitCall(lexer::Symbol callee, uint32_t numArgs, uint32_t dst);
+
+  /// '&&' and '||', with a jump over the right operand.
+  bool emitLogic(const parser::BinaryExpr& b, uint32_t dst);
+
+  static llvm::Optional<Op> binaryOp(lexer::Token tok);
+
+  Binding bind(lexer::Symbol name, uint32_t reg) {
+    auto old = vars_.find(name);
+    Binding b = old != vars_.end() ? Binding(old->second) : llvm::None;
+    vars_[name] = reg;
+    return b;
+  }
+
+  void unbind(lexer::Symbol name, Binding old) {
+    if (old) {
+      vars_[name] = *old;
+    } else {
+      vars_.erase(name);
+    }
+  }
+
+  uint32_t add(Op op, uint32_t a, uint32_t b = 0, uint32_t c = 0) {
+    p_.code_.push_back({op, a, b, c});
+    p_.numRegs_ = std::max(p_.numRegs_, a + 1);
+    return static_cast<uint32_t>(p_.code_.size() - 1);
+  }
+
+  uint32_t here() const { return static_cast<uint32_t>(p_.code_.size()); }
+
+  Program& p_;
+  llvm::DenseMap<lexer::Symbol, uint32_t> vars_;
+  llvm::DenseMap<lexer::Symbol, uint32_t> callees_;
+};
+
+bool Compiler::emit(const parser::Expr& e, uint32_t dst) {
+  using parser::Expr;
+  switch (e.kind()) {
+    case Expr::Kind::Number:
+      p_.consts_.push_back(llvm::cast<parser::NumberExpr>(e).getVal());
+      add(Op::Const, dst, static_cast<uint32_t>(p_.consts_.size() - 1));
+      return true;
+
+    case Expr::Kind::Variable: {
+      auto v = vars_.find(llvm::cast<parser::VariableExpr>(e).getName());
+      if (v == vars_.end()) {
+        return false;
+      }
+      add(Op::Move, dst, v->second);
+      return true;
+    }
+
+    case Expr::Kind::Binary: {
+      auto& b = llvm::cast<parser::BinaryExpr>(e);
+      if (b.getUserFn() == lexer::kNoSymbol && parser::isLogic(b.getOp())) {
+        return emitLogic(b, dst);
+      }
+      if (!emit(*b.getLHS(), dst) || !emit(*b.getRHS(), dst + 1)) {
+        return false;
+      }
+      if (b.getUserFn() != lexer::kNoSymbol) {
+        return emitCall(b.getUserFn(), 2, dst);
+      }
+      auto op = binaryOp(b.getOp());
+      if (!op) {
+        return false;
+      }
+      add(*op, dst, dst, dst + 1);
+      return true;
+    }
+
+    case Expr::Kind::Unary: {
+      auto& u = llvm::cast<parser::UnaryExpr>(e);
+      if (u.getUserFn() == lexer::kNoSymbol || !emit(*u.getOperand(), dst)) {
+        return false;
+      }
+      return emitCall(u.getUserFn(), 1, dst);
+    }
+
+    case Expr::Kind::Call: {
+      auto& c = llvm::cast<parser::CallExpr>(e);
+      for (uint32_t i = 0; i != c.getNumArgs(); ++i) {
+        if (!emit(*c.getArg(i), dst + i)) {
+          return false;
+        }
+      }
+      return emitCall(c.getCallee(), c.getNumArgs(), dst);
+    }
+
+    case Expr::Kind::If: {
+      auto& i = llvm::cast<parser::IfExpr>(e);
+      if (!emit(*i.getCond(), dst)) {
+        return false;
+      }
+      auto toElse = add(Op::JumpIfNot, dst);
+      if (!emit(*i.getThen(), dst)) {
+        return false;
+      }
+      auto toEnd = add(Op::Jump, 0);
+      p_.code_[toElse].b = here();
+      if (!emit(*i.getElse(), dst)) {
+        return false;
+      }
+      p_.code_[toEnd].a = here();
+      return true;
+    }
+
+    case Expr::Kind::For: {
+      // dst holds the loop variable, dst + 1 the step and dst + 2 the end
+      // condition, which sees the current value like the IR does.
+      auto& f = llvm::cast<parser::ForExpr>(e);
+      if (!emit(*f.getStart(), dst)) {
+        return false;
+      }
+      auto name = f.getVarName();
+      auto old = bind(name, dst);
+
+      auto loop = here();
+      auto ok = emit(*f.getBody(), dst + 1);
+      if (ok && f.getStep() != nullptr) {
+        ok = emit(*f.getStep(), dst + 1);
+      } else if (ok) {
+        p_.consts_.push_back(1.0);
+        add(Op::Const, dst + 1, static_cast<uint32_t>(p_.consts_.size() - 1));
+      }
+      ok = ok && emit(*f.getEnd(), dst + 2);
+      unbind(name, old);
+      if (!ok) {
+        return false;
+      }
+      add(Op::Add, dst, dst, dst + 1);
+      auto toExit = add(Op::JumpIfNot, dst + 2);
+      add(Op::Jump, loop);
+      p_.code_[toExit].b = here();
+      p_.consts_.push_back(0.0);
+      add(Op::Const, dst, static_cast<uint32_t>(p_.consts_.size() - 1));
+      return true;
+    }
+
+    case Expr::Kind::Var: {
+      // the i-th variable lives in dst + i and the body runs above them.
+      auto& v = llvm::cast<parser::VarExpr>(e);
+      auto n = v.getNumVars();
+      llvm::SmallVector<Binding, 4> olds;
+      auto ok = true;
+      for (uint32_t i = 0; ok && i != n; ++i) {
+        if (v.getInit(i) != nullptr) {
+          ok = emit(*v.getInit(i), dst + i);
+        } else {
+          p_.consts_.push_back(0.0);
+          add(Op::Const, dst + i, static_cast<uint32_t>(p_.consts_.size() - 1));
+        }
+        olds.push_back(bind(v.getVarName(i), dst + i));
+      }
+      ok = ok && emit(*v.getBody(), dst + n);
+      for (auto i = olds.size(); i-- != 0;) {
+        unbind(v.getVarName(static_cast<uint32_t>(i)), olds[i]);
+      }
+      if (!ok) {
+        return false;
+      }
+      add(Op::Move, dst, dst + n);
+      return true;
+    }
+
+    case Expr::Kind::Assign: {
+      auto& a = llvm::cast<parser::AssignExpr>(e);
+      auto v = vars_.find(a.getVarName());
+      if (v == vars_.end() || !emit(*a.getValue(), dst)) {
+        return false;
+      }
+      add(Op::Move, v->second, dst);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool Compiler::emitCall(lexer::Symbol callee, uint32_t numArgs, uint32_t dst) {
+  auto known = callees_.find(callee);
+  if (known == callees_.end()) {
+    auto proto = global::getProto(callee);
+    if (proto == nullptr || proto->getArgs().size() != numArgs ||
+        numArgs > Program::kMaxArgs) {
+      return false;
+    }
+    auto sym = global::gJIT()->findSymbol(lexer::symbolName(callee).str());
+    if (!sym) {
+      return false;
+    }
+    auto addr = sym.getAddress();
+    if (!addr) {
+      llvm::consumeError(addr.takeError());
+      return false;
+    }
+    p_.callees_.push_back({callee, numArgs, *addr});
+    known = callees_
+                .insert({callee, static_cast<uint32_t>(p_.callees_.size() - 1)})
+                .first;
+  }
+  add(Op::Call, dst, known->second, dst);
+  p_.numRegs_ = std::max(p_.numRegs_, dst + numArgs);
+  return true;
+}
+
+bool Compiler::emitLogic(const parser::BinaryExpr& b, uint32_t dst) {
+  if (!emit(*b.getLHS(), dst)) {
+    return false;
+  }
+  // '&&' is decided by a false left operand, '||' by a true one.
+  auto isAnd = b.getOp() == lexer::Token::OpLogicAnd;
+  add(Op::Truth, dst, dst);
+  auto ifFalse = add(Op::JumpIfNot, dst);
+  uint32_t toEnd = 0;
+  if (!isAnd) {
+    toEnd = add(Op::Jump, 0);
+    p_.code_[ifFalse].b = here();
+  }
+  if (!emit(*b.getRHS(), dst)) {
+    return false;
+  }
+  add(Op::Truth, dst, dst);
+  if (isAnd) {
+    p_.code_[ifFalse].b = here();
+  } else {
+    p_.code_[toEnd].a = here();
+  }
+  return true;
+}
+
+llvm::Optional<Op> Compiler::binaryOp(lexer::Token tok) {
+  switch (tok) {
+    case lexer::Token::OpAdd:
+      return Op::Add;
+    case lexer::Token::OpSub:
+      return Op::Sub;
+    case lexer::Token::OpMul:
+      return Op::Mul;
+    case lexer::Token::OpDiv:
+      return Op::Div;
+    case lexer::Token::OpLess:
+      return Op::Less;
+    case lexer::Token::OpGreat:
+      return Op::Greater;
+    case lexer::Token::OpLE:
+      return Op::LessEq;
+    case lexer::Token::OpGE:
+      return Op::GreaterEq;
+    case lexer::Token::OpEQ:
+      return Op::Equal;
+    case lexer::Token::OpNE:
+      return Op::NotEqual;
+    default:
+      return llvm::None;
+  }
+}
+
+std::unique_ptr<Program> Program::compile(const parser::Expr& e) {
+  auto p = std::make_unique<Program>();
+  Compiler c(*p);
+  if (!c.emit(e, 0)) {
+    return nullptr;
+  }
+  p->code_.push_back({Op::Return, 0, 0, 0});
+  p->numRegs_ = std::max<uint32_t>(p->numRegs_, 1);
+  return p;
+}
+
+}  // namespace interp
+}  // namespace kaso
@@ -0,0 +1,191 @@
+#include "interp/Interpreter.h"
+#include <llvm/ADT/SmallVector.h>
+#include "parser/Builtin.h"
+
+namespace kaso {
+namespace interp {
+
+namespace {
+
+double call(uint64_t addr, uint32_t arity, const double* a) {
+  auto p = static_cast<intptr_t>(addr);
+  switch (arity) {
+    case 0:
+      return reinterpret_cast<double (*)()>(p)();
+    case 1:
+      return reinterpret_cast<double (*)(double)>(p)(a[0]);
+    case 2:
+      return reinterpret_cast<double (*)(double, double)>(p)(a[0], a[1]);
+    case 3:
+      return reinterpret_cast<double (*)(double, double, double)>(p)(
+          a[0], a[1], a[2]);
+    case 4:
+      return reinterpret_cast<double (*)(double, double, double, double)>(p)(
+          a[0], a[1], a[2], a[3]);
+    case 5:
+      return reinterpret_cast<double (*)(double, double, double, double,
+                                         double)>(p)(a[0], a[1], a[2], a[3],
+                                                     a[4]);
+    case 6:
+      return reinterpret_cast<double (*)(double, double, double, double,
+                                         double, double)>(p)(
+          a[0], a[1], a[2], a[3], a[4], a[5]);
+    case 7:
+      return reinterpret_cast<double (*)(double, double, double, double,
+                                         double, double, double)>(p)(
+          a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+    case 8:
+      return reinterpret_cast<double (*)(double, double, double, double,
+                                         double, double, double, double)>(p)(
+          a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+  }
+  llvm_unreachable("arity is checked by the compiler");
+}
+
+const char* name(Op op) {
+  switch (op) {
+    case Op::Const:
+      return "const";
+    case Op::Move:
+      return "move";
+    case Op::Add:
+      return "add";
+    case Op::Sub:
+      return "sub";
+    case Op::Mul:
+      return "mul";
+    case Op::Div:
+      return "div";
+    case Op::Less:
+      return "less";
+    case Op::Greater:
+      return "greater";
+    case Op::LessEq:
+      return "lesseq";
+    case Op::GreaterEq:
+      return "greatereq";
+    case Op::Equal:
+      return "equal";
+    case Op::NotEqual:
+      return "notequal";
+    case Op::Truth:
+      return "truth";
+    case Op::Call:
+      return "call";
+    case Op::Jump:
+      return "jump";
+    case Op::JumpIfNot:
+      return "jumpifnot";
+    case Op::Return:
+      return "return";
+  }
+  return "?";
+}
+
+}  // namespace
+
+double Program::run() const {
+  llvm::SmallVector<double, 16> r(numRegs_);
+  for (size_t pc = 0;;) {
+    auto& in = code_[pc++];
+    // what the IR computes for the operator.
+    auto eval = [&](lexer::Token op) {
+      r[in.a] = *parser::evalBinary(op, r[in.b], r[in.c]);
+    };
+    switch (in.op) {
+      case Op::Const:
+        r[in.a] = consts_[in.b];
+        break;
+      case Op::Move:
+        r[in.a] = r[in.b];
+        break;
+      case Op::Add:
+        eval(lexer::Token::OpAdd);
+        break;
+      case Op::Sub:
+        eval(lexer::Token::OpSub);
+        break;
+      case Op::Mul:
+        eval(lexer::Token::OpMul);
+        break;
+      case Op::Div:
+        eval(lexer::Token::OpDiv);
+        break;
+      case Op::Less:
+        eval(lexer::Token::OpLess);
+        break;
+      case Op::Greater:
+        eval(lexer::Token::OpGreat);
+        break;
+      case Op::LessEq:
+        eval(lexer::Token::OpLE);
+        break;
+      case Op::GreaterEq:
+        eval(lexer::Token::OpGE);
+        break;
+      case Op::Equal:
+        eval(lexer::Token::OpEQ);
+        break;
+      case Op::NotEqual:
+        eval(lexer::Token::OpNE);
+        break;
+      case Op::Truth:
+        r[in.a] = parser::isTrue(r[in.b]) ? 1.0 : 0.0;
+        break;
+      case Op::Call: {
+        auto& c = callees_[in.b];
+        r[in.a] = call(c.addr, c.arity, &r[in.c]);
+        break;
+      }
+      case Op::Jump:
+        pc = in.a;
+        break;
+      case Op::JumpIfNot:
+        if (!parser::isTrue(r[in.a])) {
+          pc = in.b;
+        }
+        break;
+      case Op::Return:
+        return r[in.a];
+    }
+  }
+}
+
+void Program::print(llvm::raw_ostream& os) const {
+  for (size_t pc = 0; pc != code_.size(); ++pc) {
+    auto& in = code_[pc];
+    os << pc << ": " << name(in.op) << " " << in.a;
+    switch (in.op) {
+      case Op::Const:
+        os << " " << consts_[in.b];
+        break;
+      case Op::Move:
+      case Op::JumpIfNot:
+      case Op::Truth:
+        os << " " << in.b;
+        break;
+      case Op::Add:
+      case Op::Sub:
+      case Op::Mul:
+      case Op::Div:
+      case Op::Less:
+      case Op::Greater:
+      case Op::LessEq:
+      case Op::GreaterEq:
+      case Op::Equal:
+      case Op::NotEqual:
+        os << " " << in.b << " " << in.c;
+        break;
+      case Op::Call:
+        os << " " << lexer::symbolName(callees_[in.b].name) << " " << in.c;
+        break;
+      case Op::Jump:
+      case Op::Return:
+        break;
+    }
+    os << "\n";
+  }
+}
+
+}  // namespace interp
+}  // namespace kaso
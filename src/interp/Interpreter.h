@@ -0,0 +1,71 @@
+#pragma once
+
+#include <llvm/Support/raw_ostream.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "parser/Expr.h"
+
+namespace kaso {
+namespace interp {
+
+enum class Op : uint8_t {
+  Const,      // r[a] = consts[b]
+  Move,       // r[a] = r[b]
+  Add,        // r[a] = r[b] + r[c]
+  Sub,        // r[a] = r[b] - r[c]
+  Mul,        // r[a] = r[b] * r[c]
+  Div,        // r[a] = r[b] / r[c]
+  Less,       // r[a] = r[b] < r[c] or unordered ? 1 : 0, as fcmp ult
+  Greater,    // r[a] = r[b] > r[c] or unordered ? 1 : 0, as fcmp ugt
+  LessEq,     // r[a] = r[b] <= r[c] or unordered ? 1 : 0, as fcmp ule
+  GreaterEq,  // r[a] = r[b] >= r[c] or unordered ? 1 : 0, as fcmp uge
+  Equal,      // r[a] = r[b] == r[c] ? 1 : 0, as fcmp oeq
+  NotEqual,   // r[a] = r[b] != r[c] ? 1 : 0, as fcmp une
+  Truth,      // r[a] = r[b] is ordered and not 0 ? 1 : 0
+  Call,       // r[a] = callees[b](r[c], ..., r[c + arity - 1])
+  Jump,       // pc = a
+  JumpIfNot,  // pc = b unless r[a] is ordered and not 0, as fcmp one
+  Return,     // return r[a]
+};
+
+struct Instr {
+  Op op;
+  uint32_t a, b, c;
+};
+
+/// A top-level expression compiled to register bytecode, so that a one-shot
+/// evaluation does not have to build, JIT and drop an LLVM module. Every
+/// result gets the same value the IR would compute. Calls go to JIT-compiled
+/// and host functions through the addresses the JIT resolves when the
+/// program is compiled.
+class Program {
+ public:
+  static const uint32_t kMaxArgs = 8;
+
+  /// Returns nullptr when e cannot be interpreted: an unknown name, a wrong
+  /// number of arguments, more than kMaxArgs of them or an operator without
+  /// a definition. Compiling it with LLVM reports the error.
+  static std::unique_ptr<Program> compile(const parser::Expr& e);
+
+  double run() const;
+
+  void print(llvm::raw_ostream& os) const;
+
+ private:
+  friend class Compiler;
+
+  struct Callee {
+    lexer::Symbol name;
+    uint32_t arity;
+    uint64_t addr;
+  };
+
+  std::vector<Instr> code_;
+  std::vector<double> consts_;
+  std::vector<Callee> callees_;
+  uint32_t numRegs_ = 0;
+};
+
+}  // namespace interp
+}  // namespace kaso
@@ -1,14 +1,69 @@
 #include "lexer/Lexer.h"
-#include <map>
+#include <vector>
+#include "lexer/Number.h"
+#include "lexer/Scanner.h"
 
 namespace kaso {
 namespace lexer {
 
-Lexer::Lexer(std::istream& is) : lastChar_(' '), numVal_(0.0), is_(is) {}
+namespace {
+// keyword recognition is a single index on the interned id of the word.
+Token keyword(Symbol sym) {
+  static const std::vector<Token> keywords = [] {
+    const std::pair<const char*, Token> words[] = {
+        {"def", Token::Def},       {"extern", Token::Extern},
+        {"if", Token::If},         {"then", Token::Then},
+        {"else", Token::Else},     {"for", Token::For},
+        {"in", Token::In},         {"var", Token::Var},
+        {"binary", Token::Binary}, {"unary", Token::Unary}};
+    std::vector<Token> table;
+    for (const auto& w : words) {
+      auto sym = intern(w.first);
+      if (sym >= table.size()) {
+        table.resize(sym + 1, Token::Identifier);
+      }
+      table[sym] = w.second;
+    }
+    return table;
+  }();
+  return sym < keywords.size() ? keywords[sym] : Token::Identifier;
+}
+
+bool isAlpha(char c) { return std::isalpha(static_cast<unsigned char>(c)); }
+bool isDigit(char c) { return std::isdigit(static_cast<unsigned char>(c)); }
+}  // namespace
+
+Lexer::Lexer(std::istream& is)
+    : is_(&is),
+      lastChar_(' '),
+      numVal_(0.0),
+      symVal_(0),
+      bufStart_(nullptr),
+      bufEnd_(nullptr),
+      cur_(nullptr),
+      tokStart_(nullptr) {}
 
-Token Lexer::getTok() {
+Lexer::Lexer(llvm::StringRef buf)
+    : is_(nullptr),
+      lastChar_(' '),
+      numVal_(0.0),
+      symVal_(0),
+      bufStart_(buf.begin()),
+      bufEnd_(buf.end()),
+      cur_(buf.begin()),
+      tokStart_(buf.begin()) {}
+
+Lexer::Lexer(std::shared_ptr<llvm::MemoryBuffer> file)
+    : Lexer(file->getBuffer()) {
+  file_ = std::move(file);
+}
+
+Token Lexer::getTok() { return is_ ? getStreamTok() : getBufferTok(); }
+
+Token Lexer::getStreamTok() {
+  auto& is = *is_;
   while (std::isspace(lastChar_)) {
-    lastChar_ = is_.get();
+    lastChar_ = is.get();
   }
 
   auto tok = Token::Error;
@@ -26,36 +81,36 @@ Token Lexer::getTok() {
       tok = Token::RightParen;
       break;
     case '=':
-      lastChar_ = is_.get();
+      lastChar_ = is.get();
       if (lastChar_ == '=') {
         tok = Token::OpEQ;
         strVal_ = "==";
       } else {
         tok = Token::OpAssign;
         strVal_ = "=";
-        is_.unget();
+        is.unget();
       }
       break;
     case '>':
-      lastChar_ = is_.get();
+      lastChar_ = is.get();
       if (lastChar_ == '=') {
         tok = Token::OpGE;
         strVal_ = ">=";
       } else {
         tok = Token::OpGreat;
         strVal_ = ">";
-        is_.unget();
+        is.unget();
       }
       break;
     case '<':
-      lastChar_ = is_.get();
+      lastChar_ = is.get();
       if (lastChar_ == '=') {
         tok = Token::OpLE;
         strVal_ = "<=";
       } else {
         tok = Token::OpLess;
         strVal_ = "<";
-        is_.unget();
+        is.unget();
       }
       break;
     case ':':
@@ -63,7 +118,7 @@ Token Lexer::getTok() {
       strVal_ = ":";
       break;
     case '&':
-      lastChar_ = is_.get();
+      lastChar_ = is.get();
       if (lastChar_ == '&') {
         tok = Token::OpLogicAnd;
         strVal_ = "&&";
@@ -72,7 +127,7 @@ Token Lexer::getTok() {
         return Token::Error;
       }
     case '|':
-      lastChar_ = is_.get();
+      lastChar_ = is.get();
       if (lastChar_ == '|') {
         tok = Token::OpLogicOr;
         strVal_ = "||";
@@ -97,71 +152,66 @@ Token Lexer::getTok() {
       strVal_ = "/";
       break;
     case '!':
-      tok = Token::OpNegate;
-      strVal_ = "!";
+      lastChar_ = is.get();
+      if (lastChar_ == '=') {
+        tok = Token::OpNE;
+        strVal_ = "!=";
+      } else {
+        tok = Token::OpNegate;
+        strVal_ = "!";
+        is.unget();
+      }
       break;
     default:
       break;
   }
   if (tok != Token::Error) {
-    lastChar_ = is_.get();
+    lastChar_ = is.get();
     return tok;
   }
 
   if (std::isalpha(lastChar_)) {
     strVal_ = static_cast<char>(lastChar_);
-    while (std::isalnum((lastChar_ = is_.get()))) {
+    while (std::isalnum((lastChar_ = is.get()))) {
       strVal_ += static_cast<char>(lastChar_);
     }
 
-    if (strVal_ == "def") {
-      return Token::Def;
-    }
-    if (strVal_ == "extern") {
-      return Token::Extern;
-    }
-    if (strVal_ == "if") {
-      return Token::If;
-    }
-    if (strVal_ == "then") {
-      return Token::Then;
-    }
-    if (strVal_ == "else") {
-      return Token::Else;
-    }
-    if (strVal_ == "for") {
-      return Token::For;
-    }
-    if (strVal_ == "in") {
-      return Token::In;
-    }
-    if (strVal_ == "binary") {
-      return Token::Binary;
-    }
-    if (strVal_ == "unary") {
-      return Token::Unary;
-    }
-    return Token::Identifier;
+    symVal_ = intern(strVal_);
+    return keyword(symVal_);
   }
 
   if (std::isdigit(lastChar_) || lastChar_ == '.') {
-    std::string numStr;
+    // strVal_ keeps its capacity between tokens, so this does not allocate
+    // once it has grown to the longest literal seen.
+    strVal_.clear();
+    auto hex = false;
     do {
-      numStr += static_cast<char>(lastChar_);
-      lastChar_ = is_.get();
-    } while (std::isdigit(lastChar_) || lastChar_ == '.');
+      strVal_ += static_cast<char>(lastChar_);
+      hex |= strVal_.size() == 2 && strVal_[0] == '0' &&
+             (strVal_[1] | 0x20) == 'x';
+      lastChar_ = is.get();
+    } while (lastChar_ != EOF &&
+             continuesNumber(strVal_.back(), lastChar_, hex));
 
-    numVal_ = std::stod(numStr);
-    return Token::Number;
+    return parseNumber(strVal_, numVal_) ? Token::Number : Token::Error;
+  }
+
+  if (lastChar_ == '%') {
+    strVal_.clear();
+    do {
+      strVal_ += static_cast<char>(lastChar_);
+      lastChar_ = is.get();
+    } while (lastChar_ != EOF && lastChar_ != '\n' && lastChar_ != '\r');
+    return Token::Command;
   }
 
   if (lastChar_ == '#') {
     do {
-      lastChar_ = is_.get();
+      lastChar_ = is.get();
     } while (lastChar_ != EOF && lastChar_ != '\n' && lastChar_ != '\r');
 
     if (lastChar_ != EOF) {
-      return getTok();
+      return getStreamTok();
     }
   }
 
@@ -172,26 +222,180 @@ Token Lexer::getTok() {
   return Token::Error;
 }
 
+Token Lexer::getBufferTok() {
+  // skip whitespace and comments up to the next token.
+  while (true) {
+    cur_ = scan::skipSpace(cur_, bufEnd_);
+    if (cur_ == bufEnd_ || *cur_ != '#') {
+      break;
+    }
+    cur_ = scan::skipLine(cur_, bufEnd_);
+  }
+
+  tokStart_ = cur_;
+  if (cur_ == bufEnd_) {
+    return Token::Eof;
+  }
+
+  auto follows = [this](char c) {
+    if (cur_ != bufEnd_ && *cur_ == c) {
+      ++cur_;
+      return true;
+    }
+    return false;
+  };
+
+  auto c = *cur_++;
+  switch (c) {
+    case ',':
+      return Token::Comma;
+    case ';':
+      return Token::Semicolon;
+    case '(':
+      return Token::LeftParen;
+    case ')':
+      return Token::RightParen;
+    case '=':
+      return follows('=') ? Token::OpEQ : Token::OpAssign;
+    case '>':
+      return follows('=') ? Token::OpGE : Token::OpGreat;
+    case '<':
+      return follows('=') ? Token::OpLE : Token::OpLess;
+    case ':':
+      return Token::OpColon;
+    case '&':
+      return follows('&') ? Token::OpLogicAnd : Token::Error;
+    case '|':
+      return follows('|') ? Token::OpLogicOr : Token::Error;
+    case '+':
+      return Token::OpAdd;
+    case '-':
+      return Token::OpSub;
+    case '*':
+      return Token::OpMul;
+    case '/':
+      return Token::OpDiv;
+    case '!':
+      return follows('=') ? Token::OpNE : Token::OpNegate;
+    case '%':
+      cur_ = scan::skipLine(cur_, bufEnd_);
+      return Token::Command;
+    default:
+      break;
+  }
+
+  if (isAlpha(c)) {
+    cur_ = scan::skipIdent(cur_, bufEnd_);
+    symVal_ = intern(strRef());
+    return keyword(symVal_);
+  }
+
+  if (isDigit(c) || c == '.') {
+    cur_ = scanNumber(tokStart_, bufEnd_);
+    return parseNumber(strRef(), numVal_) ? Token::Number : Token::Error;
+  }
+
+  return Token::Error;
+}
+
 double Lexer::numVal() { return numVal_; }
 
-std::string Lexer::strVal() { return strVal_; }
+std::string Lexer::strVal() { return is_ ? strVal_ : strRef().str(); }
+
+Symbol Lexer::symVal() { return symVal_; }
+
+llvm::StringRef Lexer::strRef() {
+  if (is_) {
+    return strVal_;
+  }
+  return llvm::StringRef(tokStart_, cur_ - tokStart_);
+}
+
+size_t Lexer::tokOffset() { return is_ ? 0 : tokStart_ - bufStart_; }
+
+size_t Lexer::tokLength() { return is_ ? 0 : cur_ - tokStart_; }
+
+std::shared_ptr<llvm::MemoryBuffer> loadSource(const std::string& path) {
+  // the lexer bounds-checks every read, so no terminator is needed and page
+  // aligned files can be mapped directly.
+  auto buf = llvm::MemoryBuffer::getFile(path, -1, false);
+  if (!buf) {
+    fprintf(stderr, "LogError: cannot read %s: %s\n", path.c_str(),
+            buf.getError().message().c_str());
+    return nullptr;
+  }
+  return std::shared_ptr<llvm::MemoryBuffer>(std::move(*buf));
+}
+
+const char* spelling(Token tok) {
+  switch (tok) {
+    case Token::Comma:
+      return ",";
+    case Token::Semicolon:
+      return ";";
+    case Token::LeftParen:
+      return "(";
+    case Token::RightParen:
+      return ")";
+    case Token::OpAssign:
+      return "=";
+    case Token::OpEQ:
+      return "==";
+    case Token::OpNE:
+      return "!=";
+    case Token::OpLess:
+      return "<";
+    case Token::OpGreat:
+      return ">";
+    case Token::OpLE:
+      return "<=";
+    case Token::OpGE:
+      return ">=";
+    case Token::OpColon:
+      return ":";
+    case Token::OpLogicAnd:
+      return "&&";
+    case Token::OpLogicOr:
+      return "||";
+    case Token::OpAdd:
+      return "+";
+    case Token::OpSub:
+      return "-";
+    case Token::OpMul:
+      return "*";
+    case Token::OpDiv:
+      return "/";
+    case Token::OpNegate:
+      return "!";
+    default:
+      return "";
+  }
+}
 
 bool isValidUnaryOperator(Token tok) {
-  static const std::map<Token, bool> validUnary = {{Token::OpNegate, true},
-                                                   {Token::OpSub, true}};
-  return validUnary.find(tok) != validUnary.end();
+  return tok == Token::OpNegate || tok == Token::OpSub;
 }
 
 bool isValidBinaryOperator(Token tok) {
-  static const std::map<Token, bool> validBinary = {
-      {Token::OpAssign, true},   {Token::OpEQ, true},
-      {Token::OpNE, true},       {Token::OpLess, true},
-      {Token::OpGreat, true},    {Token::OpLE, true},
-      {Token::OpGE, true},       {Token::OpColon, true},
-      {Token::OpLogicAnd, true}, {Token::OpLogicOr, true},
-      {Token::OpAdd, true},      {Token::OpSub, true},
-      {Token::OpMul, true},      {Token::OpDiv, true}};
-  return validBinary.find(tok) != validBinary.end();
+  switch (tok) {
+    case Token::OpAssign:
+    case Token::OpEQ:
+    case Token::OpNE:
+    case Token::OpLess:
+    case Token::OpGreat:
+    case Token::OpLE:
+    case Token::OpGE:
+    case Token::OpColon:
+    case Token::OpLogicAnd:
+    case Token::OpLogicOr:
+    case Token::OpAdd:
+    case Token::OpSub:
+    case Token::OpMul:
+    case Token::OpDiv:
+      return true;
+    default:
+      return false;
+  }
 }
 
 }  // namespace lexer
@@ -1,7 +1,11 @@
 #pragma once
 
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
 #include <istream>
+#include <memory>
 #include <string>
+#include "lexer/Symbol.h"
 
 namespace kaso {
 namespace lexer {
@@ -20,9 +24,12 @@ enum class Token {
   Else,    // else
   For,     // for
   In,      // in
+  Var,     // var
   Binary,  // binary
   Unary,   // unary
 
+  Command,  // %name arguments, up to the end of the line
+
   Comma,       // ,
   Semicolon,   // ;
   LeftParen,   // (
@@ -49,23 +56,64 @@ enum class Token {
   OpNegate,  // !
 };
 
+const size_t kNumTokens = static_cast<size_t>(Token::OpNegate) + 1;
+
 class Lexer {
  public:
+  /// Lexes an input stream one character at a time, e.g. interactive stdin.
   explicit Lexer(std::istream& is);
 
+  /// Lexes a contiguous buffer in place. Tokens are views into the buffer, so
+  /// it must outlive the lexer and every StringRef handed out by strRef().
+  explicit Lexer(llvm::StringRef buf);
+
+  /// Lexes a whole source file, keeping the (possibly mmap'd) buffer alive.
+  explicit Lexer(std::shared_ptr<llvm::MemoryBuffer> file);
+
   Token getTok();
 
   double numVal();
 
   std::string strVal();
 
+  /// Interned name of the current identifier or keyword.
+  Symbol symVal();
+
+  /// Text of the current token without copying it. In buffer mode this points
+  /// into the source buffer; in stream mode it is only valid until the next
+  /// call to getTok().
+  llvm::StringRef strRef();
+
+  /// Offset and length of the current token in the source buffer. Both are
+  /// zero in stream mode.
+  size_t tokOffset();
+  size_t tokLength();
+
+ private:
+  Token getStreamTok();
+  Token getBufferTok();
+
  private:
-  std::istream& is_;
+  std::istream* is_;
   int lastChar_;
   double numVal_;
   std::string strVal_;
+  Symbol symVal_;
+
+  std::shared_ptr<llvm::MemoryBuffer> file_;
+  const char* bufStart_;
+  const char* bufEnd_;
+  const char* cur_;
+  const char* tokStart_;
 };
 
+/// Maps a whole source file into memory (mmap for large files). Returns
+/// nullptr and prints the reason if the file cannot be read.
+std::shared_ptr<llvm::MemoryBuffer> loadSource(const std::string& path);
+
+/// Source spelling of an operator or punctuation token, "" for the others.
+const char* spelling(Token tok);
+
 bool isValidUnaryOperator(Token tok);
 bool isValidBinaryOperator(Token tok);
 
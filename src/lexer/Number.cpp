@@ -0,0 +1,255 @@
+#include "lexer/Number.h"
+#include <llvm/ADT/APFloat.h>
+#include <cstdint>
+#include <cstring>
+
+namespace kaso {
+namespace lexer {
+
+namespace {
+
+bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+int hexValue(char c) {
+  if (isDigit(c)) {
+    return c - '0';
+  }
+  c |= 0x20;
+  return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+bool isAlnum(char c) {
+  return isDigit(c) || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z');
+}
+
+// powers of ten that are exact in a double.
+const double kExactPow10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+                              1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+                              1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+const int kMaxExactPow10 = 22;
+const uint64_t kMaxExactInt = uint64_t(1) << 53;
+
+// parses an optional sign and at least one digit; the value saturates so huge
+// exponents still round to zero or infinity.
+const char* parseExponent(const char* p, const char* end, int& exp) {
+  bool neg = false;
+  if (p != end && (*p == '+' || *p == '-')) {
+    neg = *p++ == '-';
+  }
+  if (p == end || !isDigit(*p)) {
+    return nullptr;
+  }
+  exp = 0;
+  for (; p != end && isDigit(*p); ++p) {
+    if (exp < 100000) {
+      exp = exp * 10 + (*p - '0');
+    }
+  }
+  if (neg) {
+    exp = -exp;
+  }
+  return p;
+}
+
+// m * 2^exp2 rounded to nearest-even; sticky says nonzero bits were dropped
+// below m. Handles overflow to infinity and gradual underflow.
+double roundBinary(uint64_t m, int exp2, bool sticky) {
+  if (m == 0) {
+    return 0.0;
+  }
+  auto lead = 63 - __builtin_clzll(m);
+  // exponent of the leading bit, and how many low bits of m do not fit.
+  auto e = exp2 + lead;
+  auto drop = lead - 52;
+  if (e < -1022) {
+    drop += -1022 - e;
+  }
+
+  uint64_t mant = m;
+  if (drop > 0) {
+    if (drop > 64) {
+      return 0.0;
+    }
+    uint64_t rest = drop == 64 ? m : m & ((uint64_t(1) << drop) - 1);
+    mant = drop == 64 ? 0 : m >> drop;
+    uint64_t half = uint64_t(1) << (drop - 1);
+    if (rest > half || (rest == half && (sticky || (mant & 1)))) {
+      mant++;
+    }
+  } else {
+    mant = m << -drop;
+  }
+
+  // rounding may carry into the next binade.
+  if (mant == (uint64_t(1) << 53)) {
+    mant >>= 1;
+    e++;
+  } else if (e < -1022 && mant == (uint64_t(1) << 52)) {
+    e = -1022;
+  }
+
+  uint64_t bits;
+  if (e > 1023) {
+    bits = uint64_t(0x7ff) << 52;
+  } else if (mant < (uint64_t(1) << 52)) {
+    bits = mant;  // subnormal
+  } else {
+    bits = (uint64_t(e + 1023) << 52) | (mant & ((uint64_t(1) << 52) - 1));
+  }
+  double val;
+  std::memcpy(&val, &bits, sizeof(val));
+  return val;
+}
+
+bool parseHex(const char* p, const char* end, double& val) {
+  uint64_t m = 0;
+  int exp2 = 0;
+  bool sticky = false, dot = false, any = false;
+  for (; p != end; ++p) {
+    if (*p == '.') {
+      if (dot) {
+        return false;
+      }
+      dot = true;
+      continue;
+    }
+    auto d = hexValue(*p);
+    if (d < 0) {
+      break;
+    }
+    any = true;
+    if (m >> 60 == 0) {
+      m = m << 4 | d;
+      exp2 -= dot ? 4 : 0;
+    } else {
+      sticky |= d != 0;
+      exp2 += dot ? 0 : 4;
+    }
+  }
+  if (!any) {
+    return false;
+  }
+  if (p != end && (*p | 0x20) == 'p') {
+    int exp = 0;
+    p = parseExponent(p + 1, end, exp);
+    if (p == nullptr) {
+      return false;
+    }
+    exp2 += exp;
+  }
+  if (p != end) {
+    return false;
+  }
+  val = roundBinary(m, exp2, sticky);
+  return true;
+}
+
+bool parseDecimal(llvm::StringRef text, double& val) {
+  auto p = text.begin(), end = text.end();
+  uint64_t m = 0;
+  int digits = 0, exp10 = 0;
+  bool truncated = false, dot = false, any = false;
+  for (; p != end; ++p) {
+    if (*p == '.') {
+      if (dot) {
+        return false;
+      }
+      dot = true;
+      continue;
+    }
+    if (!isDigit(*p)) {
+      break;
+    }
+    any = true;
+    auto d = *p - '0';
+    if (m == 0 && d == 0) {
+      exp10 -= dot ? 1 : 0;
+    } else if (digits < 19) {
+      m = m * 10 + d;
+      digits++;
+      exp10 -= dot ? 1 : 0;
+    } else {
+      truncated |= d != 0;
+      exp10 += dot ? 0 : 1;
+    }
+  }
+  if (!any) {
+    return false;
+  }
+  if (p != end && (*p | 0x20) == 'e') {
+    int exp = 0;
+    p = parseExponent(p + 1, end, exp);
+    if (p == nullptr) {
+      return false;
+    }
+    exp10 += exp;
+  }
+  if (p != end) {
+    return false;
+  }
+
+  if (m == 0) {
+    val = 0.0;
+    return true;
+  }
+
+  // Clinger's fast path: both operands are exact doubles, so the single
+  // multiplication or division is correctly rounded.
+  if (!truncated && m <= kMaxExactInt) {
+    if (exp10 >= 0 && exp10 <= kMaxExactPow10) {
+      val = double(m) * kExactPow10[exp10];
+      return true;
+    }
+    if (exp10 < 0 && exp10 >= -kMaxExactPow10) {
+      val = double(m) / kExactPow10[-exp10];
+      return true;
+    }
+    // 123e25: move part of the exponent into the mantissa while it stays
+    // exact.
+    if (exp10 > kMaxExactPow10 && exp10 <= kMaxExactPow10 + 15) {
+      auto shifted = m;
+      auto i = exp10 - kMaxExactPow10;
+      for (; i > 0 && shifted <= kMaxExactInt / 10; i--) {
+        shifted *= 10;
+      }
+      if (i == 0) {
+        val = double(shifted) * kExactPow10[kMaxExactPow10];
+        return true;
+      }
+    }
+  }
+
+  // everything else takes the exact big-number path. It only allocates for
+  // literals with very long mantissas or extreme exponents.
+  llvm::APFloat f(llvm::APFloat::IEEEdouble());
+  f.convertFromString(text, llvm::APFloat::rmNearestTiesToEven);
+  val = f.convertToDouble();
+  return true;
+}
+
+}  // namespace
+
+bool continuesNumber(char prev, char c, bool hex) {
+  if (isAlnum(c) || c == '.' || c == '_') {
+    return true;
+  }
+  auto marker = hex ? 'p' : 'e';
+  return (c == '+' || c == '-') && (prev | 0x20) == marker;
+}
+
+const char* scanNumber(const char* p, const char* end) {
+  auto hex = end - p > 1 && p[0] == '0' && (p[1] | 0x20) == 'x';
+  for (++p; p != end && continuesNumber(p[-1], *p, hex); ++p) {
+  }
+  return p;
+}
+
+bool parseNumber(llvm::StringRef text, double& val) {
+  if (text.size() > 2 && text[0] == '0' && (text[1] | 0x20) == 'x') {
+    return parseHex(text.begin() + 2, text.end(), val);
+  }
+  return parseDecimal(text, val);
+}
+
+}  // namespace lexer
+}  // namespace kaso
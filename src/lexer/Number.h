@@ -0,0 +1,27 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+
+namespace kaso {
+namespace lexer {
+
+/// Whether c extends a numeric literal whose previous character is prev.
+/// Literals are lexed like C pp-numbers: the run takes every letter, digit and
+/// '.', plus a sign right after an exponent marker, and must then parse as a
+/// whole. This makes "1.2.3" or "12abc" one malformed token instead of
+/// silently splitting them.
+bool continuesNumber(char prev, char c, bool hex);
+
+/// Returns the end of the literal run starting at p.
+const char* scanNumber(const char* p, const char* end);
+
+/// Converts a whole literal, correctly rounded to nearest-even and without
+/// depending on the locale:
+///   decimal ::= (digits ('.' digits?)? | '.' digits) (('e'|'E') sign? digits)?
+///   hex     ::= '0' ('x'|'X') (hexdigits ('.' hexdigits?)? | '.' hexdigits)
+///               (('p'|'P') sign? digits)?
+/// Returns false if text is not a well-formed literal.
+bool parseNumber(llvm::StringRef text, double& val);
+
+}  // namespace lexer
+}  // namespace kaso
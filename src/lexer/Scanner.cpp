@@ -0,0 +1,240 @@
+#include "lexer/Scanner.h"
+#include <cstdint>
+#include <initializer_list>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define KASO_SCAN_X86 1
+#endif
+
+namespace kaso {
+namespace lexer {
+namespace scan {
+
+namespace {
+
+// character classes of the "C" locale, which is what the lexer assumes.
+enum : uint8_t { kSpace = 1, kIdent = 2, kNewline = 4 };
+
+struct ClassTable {
+  uint8_t cls[256];
+
+  ClassTable() : cls() {
+    for (auto c : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+      cls[static_cast<uint8_t>(c)] |= kSpace;
+    }
+    for (auto c = '0'; c <= '9'; c++) {
+      cls[static_cast<uint8_t>(c)] |= kIdent;
+    }
+    for (auto c = 'a'; c <= 'z'; c++) {
+      cls[static_cast<uint8_t>(c)] |= kIdent;
+      cls[static_cast<uint8_t>(c - 'a' + 'A')] |= kIdent;
+    }
+    cls[static_cast<uint8_t>('\n')] |= kNewline;
+    cls[static_cast<uint8_t>('\r')] |= kNewline;
+  }
+};
+
+const ClassTable table;
+
+template <uint8_t Cls, bool Match>
+const char* scalarScan(const char* p, const char* end) {
+  while (p != end &&
+         ((table.cls[static_cast<uint8_t>(*p)] & Cls) != 0) == Match) {
+    ++p;
+  }
+  return p;
+}
+
+const char* scalarSpace(const char* p, const char* end) {
+  return scalarScan<kSpace, true>(p, end);
+}
+
+const char* scalarIdent(const char* p, const char* end) {
+  return scalarScan<kIdent, true>(p, end);
+}
+
+const char* scalarLine(const char* p, const char* end) {
+  return scalarScan<kNewline, false>(p, end);
+}
+
+#ifdef KASO_SCAN_X86
+
+// Each kernel classifies a whole vector, turns the per-byte result into a bit
+// mask and stops at the first byte that ends the run. The tail shorter than a
+// vector goes through the scalar loop so we never read past end.
+
+// x in [lo, lo + n] as an unsigned byte compare: (x - lo) saturating-minus n
+// is zero exactly for the bytes in range.
+#define KASO_IN_RANGE(SUB, SUBS, CMPEQ, SET1, ZERO, x, lo, n) \
+  CMPEQ(SUBS(SUB(x, SET1(lo)), SET1(n)), ZERO)
+
+inline __m128i isSpace128(__m128i v) {
+  auto ctl = KASO_IN_RANGE(_mm_sub_epi8, _mm_subs_epu8, _mm_cmpeq_epi8,
+                           _mm_set1_epi8, _mm_setzero_si128(), v, 9, 4);
+  return _mm_or_si128(ctl, _mm_cmpeq_epi8(v, _mm_set1_epi8(' ')));
+}
+
+inline __m128i isIdent128(__m128i v) {
+  auto digit = KASO_IN_RANGE(_mm_sub_epi8, _mm_subs_epu8, _mm_cmpeq_epi8,
+                             _mm_set1_epi8, _mm_setzero_si128(), v, '0', 9);
+  auto lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+  auto alpha = KASO_IN_RANGE(_mm_sub_epi8, _mm_subs_epu8, _mm_cmpeq_epi8,
+                             _mm_set1_epi8, _mm_setzero_si128(), lower, 'a',
+                             25);
+  return _mm_or_si128(digit, alpha);
+}
+
+inline __m128i isNewline128(__m128i v) {
+  return _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                      _mm_cmpeq_epi8(v, _mm_set1_epi8('\r')));
+}
+
+#define KASO_KERNEL(ATTR, NAME, VEC, LOAD, MOVEMASK, CLASSIFY, MATCH, TAIL)  \
+  ATTR const char* NAME(const char* p, const char* end) {                    \
+    const auto WIDTH = static_cast<int>(sizeof(VEC));                        \
+    while (end - p >= WIDTH) {                                               \
+      auto v = LOAD(reinterpret_cast<const VEC*>(p));                        \
+      uint32_t mask = MOVEMASK(CLASSIFY(v));                                 \
+      if (MATCH) {                                                           \
+        mask = ~mask;                                                        \
+      }                                                                      \
+      mask &= 0xffffffffu >> (32 - WIDTH);                                   \
+      if (mask != 0) {                                                       \
+        return p + __builtin_ctz(mask);                                      \
+      }                                                                      \
+      p += WIDTH;                                                            \
+    }                                                                        \
+    return TAIL(p, end);                                                     \
+  }
+
+KASO_KERNEL(, sse2Space, __m128i, _mm_loadu_si128, _mm_movemask_epi8,
+            isSpace128, true, scalarSpace)
+KASO_KERNEL(, sse2Ident, __m128i, _mm_loadu_si128, _mm_movemask_epi8,
+            isIdent128, true, scalarIdent)
+KASO_KERNEL(, sse2Line, __m128i, _mm_loadu_si128, _mm_movemask_epi8,
+            isNewline128, false, scalarLine)
+
+#define KASO_AVX2 __attribute__((target("avx2")))
+
+KASO_AVX2 inline __m256i isSpace256(__m256i v) {
+  auto ctl =
+      KASO_IN_RANGE(_mm256_sub_epi8, _mm256_subs_epu8, _mm256_cmpeq_epi8,
+                    _mm256_set1_epi8, _mm256_setzero_si256(), v, 9, 4);
+  return _mm256_or_si256(ctl, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+}
+
+KASO_AVX2 inline __m256i isIdent256(__m256i v) {
+  auto digit =
+      KASO_IN_RANGE(_mm256_sub_epi8, _mm256_subs_epu8, _mm256_cmpeq_epi8,
+                    _mm256_set1_epi8, _mm256_setzero_si256(), v, '0', 9);
+  auto lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+  auto alpha =
+      KASO_IN_RANGE(_mm256_sub_epi8, _mm256_subs_epu8, _mm256_cmpeq_epi8,
+                    _mm256_set1_epi8, _mm256_setzero_si256(), lower, 'a', 25);
+  return _mm256_or_si256(digit, alpha);
+}
+
+KASO_AVX2 inline __m256i isNewline256(__m256i v) {
+  return _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                         _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\r')));
+}
+
+KASO_KERNEL(KASO_AVX2, avx2Space, __m256i, _mm256_loadu_si256,
+            _mm256_movemask_epi8, isSpace256, true, sse2Space)
+KASO_KERNEL(KASO_AVX2, avx2Ident, __m256i, _mm256_loadu_si256,
+            _mm256_movemask_epi8, isIdent256, true, sse2Ident)
+KASO_KERNEL(KASO_AVX2, avx2Line, __m256i, _mm256_loadu_si256,
+            _mm256_movemask_epi8, isNewline256, false, sse2Line)
+
+#endif  // KASO_SCAN_X86
+
+struct Kernels {
+  Isa isa;
+  const char* (*space)(const char*, const char*);
+  const char* (*ident)(const char*, const char*);
+  const char* (*line)(const char*, const char*);
+};
+
+bool supported(Isa isa) {
+#ifdef KASO_SCAN_X86
+  // detection may run from a static initializer, before the runtime has
+  // probed the CPU on its own.
+  __builtin_cpu_init();
+#endif
+  switch (isa) {
+    case Isa::Scalar:
+      return true;
+#ifdef KASO_SCAN_X86
+    case Isa::SSE2:
+      return __builtin_cpu_supports("sse2");
+    case Isa::AVX2:
+      return __builtin_cpu_supports("avx2");
+#endif
+    default:
+      return false;
+  }
+}
+
+Kernels kernelsFor(Isa isa) {
+  switch (isa) {
+#ifdef KASO_SCAN_X86
+    case Isa::AVX2:
+      return {Isa::AVX2, avx2Space, avx2Ident, avx2Line};
+    case Isa::SSE2:
+      return {Isa::SSE2, sse2Space, sse2Ident, sse2Line};
+#endif
+    default:
+      return {Isa::Scalar, scalarSpace, scalarIdent, scalarLine};
+  }
+}
+
+Kernels detect() {
+  for (auto isa : {Isa::AVX2, Isa::SSE2}) {
+    if (supported(isa)) {
+      return kernelsFor(isa);
+    }
+  }
+  return kernelsFor(Isa::Scalar);
+}
+
+Kernels kernels = detect();
+
+}  // namespace
+
+const char* skipSpace(const char* p, const char* end) {
+  return kernels.space(p, end);
+}
+
+const char* skipIdent(const char* p, const char* end) {
+  return kernels.ident(p, end);
+}
+
+const char* skipLine(const char* p, const char* end) {
+  return kernels.line(p, end);
+}
+
+Isa activeIsa() { return kernels.isa; }
+
+bool setIsa(Isa isa) {
+  if (!supported(isa)) {
+    return false;
+  }
+  kernels = kernelsFor(isa);
+  return true;
+}
+
+const char* isaName(Isa isa) {
+  switch (isa) {
+    case Isa::SSE2:
+      return "sse2";
+    case Isa::AVX2:
+      return "avx2";
+    default:
+      return "scalar";
+  }
+}
+
+}  // namespace scan
+}  // namespace lexer
+}  // namespace kaso
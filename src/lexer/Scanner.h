@@ -0,0 +1,30 @@
+#pragma once
+
+namespace kaso {
+namespace lexer {
+namespace scan {
+
+/// Instruction sets the scanning kernels are built for. The best one the CPU
+/// supports is picked at startup.
+enum class Isa { Scalar, SSE2, AVX2 };
+
+/// Returns the first byte in [p, end) that is not ASCII whitespace.
+const char* skipSpace(const char* p, const char* end);
+
+/// Returns the first byte in [p, end) that is not an ASCII letter or digit.
+const char* skipIdent(const char* p, const char* end);
+
+/// Returns the first '\n' or '\r' in [p, end), or end.
+const char* skipLine(const char* p, const char* end);
+
+Isa activeIsa();
+
+/// Switches kernels, e.g. to compare them in benchmarks. Returns false if the
+/// CPU does not support isa.
+bool setIsa(Isa isa);
+
+const char* isaName(Isa isa);
+
+}  // namespace scan
+}  // namespace lexer
+}  // namespace kaso
@@ -0,0 +1,31 @@
+#include "lexer/Symbol.h"
+
+namespace kaso {
+namespace lexer {
+
+SymbolTable& SymbolTable::get() {
+  static SymbolTable table;
+  return table;
+}
+
+Symbol SymbolTable::intern(llvm::StringRef name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = ids_.insert({name, static_cast<Symbol>(names_.size())});
+  if (it.second) {
+    names_.push_back(it.first->getKey());
+  }
+  return it.first->getValue();
+}
+
+llvm::StringRef SymbolTable::name(Symbol sym) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return names_[sym];
+}
+
+size_t SymbolTable::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return names_.size();
+}
+
+}  // namespace lexer
+}  // namespace kaso
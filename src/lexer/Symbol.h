@@ -0,0 +1,49 @@
+#pragma once
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringRef.h>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace kaso {
+namespace lexer {
+
+/// An interned name. Ids are dense, start at 0 and stay valid for the whole
+/// session, so they can be compared, hashed and used as table indices directly.
+using Symbol = uint32_t;
+
+/// Marks the absence of a symbol; never returned by intern().
+const Symbol kNoSymbol = ~Symbol(0);
+
+class SymbolTable {
+ public:
+  /// The session-wide table shared by lexers, parsers and codegen.
+  static SymbolTable& get();
+
+  Symbol intern(llvm::StringRef name);
+
+  llvm::StringRef name(Symbol sym) const;
+
+  size_t size() const;
+
+ private:
+  SymbolTable() = default;
+
+ private:
+  mutable std::mutex mutex_;
+  llvm::StringMap<Symbol> ids_;
+  // points into the keys owned by ids_, which never move.
+  std::vector<llvm::StringRef> names_;
+};
+
+inline Symbol intern(llvm::StringRef name) {
+  return SymbolTable::get().intern(name);
+}
+
+inline llvm::StringRef symbolName(Symbol sym) {
+  return SymbolTable::get().name(sym);
+}
+
+}  // namespace lexer
+}  // namespace kaso
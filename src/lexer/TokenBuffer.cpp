@@ -0,0 +1,84 @@
+#include "lexer/TokenBuffer.h"
+#include <llvm/ADT/Hashing.h>
+#include <cstring>
+
+namespace kaso {
+namespace lexer {
+
+TokenBuffer::TokenBuffer(llvm::StringRef src) : src_(src) { tokenize(); }
+
+TokenBuffer::TokenBuffer(std::shared_ptr<llvm::MemoryBuffer> file)
+    : file_(std::move(file)), src_(file_->getBuffer()) {
+  tokenize();
+}
+
+void TokenBuffer::tokenize() {
+  // a rough guess from typical token density, to avoid most regrowth.
+  auto expected = src_.size() / 4 + 1;
+  kinds_.reserve(expected);
+  offsets_.reserve(expected);
+  lengths_.reserve(expected);
+  values_.reserve(expected);
+
+  Lexer lex(src_);
+  auto atItemStart = true;
+  while (true) {
+    auto tok = lex.getTok();
+    Value val;
+    switch (tok) {
+      case Token::Number:
+        val.num = lex.numVal();
+        break;
+      case Token::Identifier:
+        val.sym = lex.symVal();
+        break;
+      default:
+        val.num = 0.0;
+        break;
+    }
+
+    auto idx = static_cast<uint32_t>(kinds_.size());
+    if (tok == Token::Def || tok == Token::Extern || tok == Token::Command ||
+        (atItemStart && tok != Token::Semicolon && tok != Token::Eof)) {
+      itemStarts_.push_back(idx);
+    }
+    atItemStart = tok == Token::Semicolon || tok == Token::Command;
+
+    kinds_.push_back(static_cast<uint8_t>(tok));
+    offsets_.push_back(static_cast<uint32_t>(lex.tokOffset()));
+    lengths_.push_back(static_cast<uint32_t>(lex.tokLength()));
+    values_.push_back(val);
+
+    if (tok == Token::Eof) {
+      break;
+    }
+  }
+}
+
+uint64_t TokenBuffer::hash(size_t begin, size_t end) const {
+  llvm::hash_code h = end - begin;
+  for (auto i = begin; i != end; ++i) {
+    switch (kind(i)) {
+      case Token::Number: {
+        uint64_t bits;
+        auto val = numVal(i);
+        std::memcpy(&bits, &val, sizeof(bits));
+        h = llvm::hash_combine(h, kinds_[i], bits);
+        break;
+      }
+      case Token::Identifier:
+        h = llvm::hash_combine(h, kinds_[i], symVal(i));
+        break;
+      case Token::Command:
+        h = llvm::hash_combine(h, kinds_[i], text(i));
+        break;
+      default:
+        h = llvm::hash_combine(h, kinds_[i]);
+        break;
+    }
+  }
+  return h;
+}
+
+}  // namespace lexer
+}  // namespace kaso
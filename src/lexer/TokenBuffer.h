@@ -0,0 +1,76 @@
+#pragma once
+
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "lexer/Lexer.h"
+
+namespace kaso {
+namespace lexer {
+
+/// A whole source buffer lexed in one pass into parallel arrays: token kinds,
+/// source offsets and lengths, and a numeric or interned-name payload. The
+/// parser can then index tokens directly, look ahead for free and split the
+/// input into top-level items before parsing any of them.
+class TokenBuffer {
+ public:
+  /// Tokenizes src, which must outlive the buffer. The last token is Eof.
+  explicit TokenBuffer(llvm::StringRef src);
+
+  /// Tokenizes a whole file, keeping the (possibly mmap'd) buffer alive.
+  explicit TokenBuffer(std::shared_ptr<llvm::MemoryBuffer> file);
+
+  size_t size() const { return kinds_.size(); }
+
+  Token kind(size_t i) const { return static_cast<Token>(kinds_[i]); }
+
+  uint32_t offset(size_t i) const { return offsets_[i]; }
+
+  uint32_t length(size_t i) const { return lengths_[i]; }
+
+  /// Value of a Number token.
+  double numVal(size_t i) const { return values_[i].num; }
+
+  /// Interned name of an Identifier token.
+  Symbol symVal(size_t i) const { return values_[i].sym; }
+
+  llvm::StringRef text(size_t i) const {
+    return src_.substr(offsets_[i], lengths_[i]);
+  }
+
+  llvm::StringRef source() const { return src_; }
+
+  /// Indices of the tokens that start a top-level item: every 'def',
+  /// 'extern' and command, and the first token after a ';' or a command. A
+  /// top-level expression can only be told apart from the one before it by
+  /// parsing, so consecutive expressions without ';' stay in one item.
+  const std::vector<uint32_t>& itemStarts() const { return itemStarts_; }
+
+  /// Hash of the tokens [begin, end) by kind and value, so that edits to
+  /// whitespace and comments do not change it. Symbol ids make it valid
+  /// within one session only.
+  uint64_t hash(size_t begin, size_t end) const;
+
+ private:
+  void tokenize();
+
+ private:
+  union Value {
+    double num;
+    Symbol sym;
+  };
+
+  std::shared_ptr<llvm::MemoryBuffer> file_;
+  llvm::StringRef src_;
+
+  std::vector<uint8_t> kinds_;
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> lengths_;
+  std::vector<Value> values_;
+  std::vector<uint32_t> itemStarts_;
+};
+
+}  // namespace lexer
+}  // namespace kaso
@@ -0,0 +1,195 @@
+#include "memo/Memo.h"
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/Support/MathExtras.h>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace kaso {
+namespace memo {
+
+namespace {
+
+uint64_t bits(double d) {
+  uint64_t b;
+  memcpy(&b, &d, sizeof b);
+  return b;
+}
+
+// called from the wrappers by address.
+const double* lookupResult(Cache* c, const double* args) {
+  return c->find(args);
+}
+
+void storeResult(Cache* c, const double* args, double result) {
+  c->insert(args, result);
+}
+
+struct Registry {
+  std::vector<std::unique_ptr<Cache>> all;
+  llvm::DenseMap<lexer::Symbol, Cache*> current;
+};
+
+Registry& registry() {
+  static Registry r;
+  return r;
+}
+
+}  // namespace
+
+Cache::Cache(lexer::Symbol name, unsigned arity, size_t capacity)
+    : name_(name), arity_(arity) {
+  if (capacity < kMaxProbe) {
+    capacity = kMaxProbe;
+  }
+  capacity = llvm::NextPowerOf2(capacity - 1);
+  keys_.resize(capacity * arity);
+  values_.resize(capacity);
+  used_.resize(capacity);
+}
+
+size_t Cache::home(const double* args) const {
+  // small integers differ only in their high bits, so mix those down into
+  // the slot bits (the murmur3 finalizer).
+  uint64_t h = arity_;
+  for (unsigned i = 0; i != arity_; ++i) {
+    h ^= bits(args[i]);
+    h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdull;
+    h = (h ^ (h >> 33)) * 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+  }
+  return static_cast<size_t>(h) & (capacity() - 1);
+}
+
+bool Cache::matches(size_t slot, const double* args) const {
+  // bitwise, so that NaN finds itself and -0 is not 0.
+  return memcmp(&keys_[slot * arity_], args, arity_ * sizeof(double)) == 0;
+}
+
+const double* Cache::find(const double* args) {
+  auto mask = capacity() - 1;
+  for (size_t i = 0, slot = home(args); i != kMaxProbe; ++i) {
+    auto s = (slot + i) & mask;
+    if (!used_[s]) {
+      break;
+    }
+    if (matches(s, args)) {
+      hits_++;
+      return &values_[s];
+    }
+  }
+  misses_++;
+  return nullptr;
+}
+
+void Cache::insert(const double* args, double result) {
+  auto mask = capacity() - 1;
+  auto slot = home(args);
+  for (size_t i = 0; i != kMaxProbe; ++i) {
+    auto s = (slot + i) & mask;
+    if (!used_[s] || matches(s, args)) {
+      slot = s;
+      break;
+    }
+  }
+  if (!used_[slot]) {
+    used_[slot] = true;
+    size_++;
+  }
+  std::copy(args, args + arity_, keys_.begin() + slot * arity_);
+  values_[slot] = result;
+}
+
+void Cache::clear() {
+  std::fill(used_.begin(), used_.end(), false);
+  size_ = 0;
+}
+
+Cache& cacheFor(lexer::Symbol name, unsigned arity) {
+  auto& r = registry();
+  auto& c = r.current[name];
+  if (c == nullptr || c->arity() != arity) {
+    r.all.push_back(std::make_unique<Cache>(name, arity));
+    c = r.all.back().get();
+  }
+  return *c;
+}
+
+std::vector<const Cache*> caches() {
+  std::vector<const Cache*> cs;
+  for (auto& c : registry().all) {
+    if (registry().current.lookup(c->name()) == c.get()) {
+      cs.push_back(c.get());
+    }
+  }
+  return cs;
+}
+
+void clearAll() {
+  for (auto& c : registry().all) {
+    c->clear();
+  }
+}
+
+llvm::Function* wrap(llvm::Function& f, Cache& c) {
+  auto& ctx = f.getContext();
+  llvm::IRBuilder<> b(ctx);
+  auto doubleTy = b.getDoubleTy();
+  auto doublePtrTy = doubleTy->getPointerTo();
+  auto cachePtrTy = b.getInt8PtrTy();
+  auto host = [&](const void* ptr, llvm::Type* type) {
+    return b.CreateIntToPtr(b.getInt64(reinterpret_cast<uintptr_t>(ptr)),
+                            type);
+  };
+  auto hostFn = [&](const void* fn, llvm::FunctionType* type) {
+    return host(fn, type->getPointerTo());
+  };
+
+  auto name = f.getName().str();
+  f.setName(name + ".uncached");
+  auto wrapper = llvm::Function::Create(f.getFunctionType(),
+                                        llvm::Function::ExternalLinkage, name,
+                                        f.getParent());
+  f.replaceAllUsesWith(wrapper);
+  auto entry = llvm::BasicBlock::Create(ctx, "entry", wrapper);
+  auto hit = llvm::BasicBlock::Create(ctx, "hit", wrapper);
+  auto miss = llvm::BasicBlock::Create(ctx, "miss", wrapper);
+
+  // the key is the arguments in a stack array.
+  b.SetInsertPoint(entry);
+  auto keyTy = llvm::ArrayType::get(doubleTy, std::max(1u, c.arity()));
+  auto key = b.CreateAlloca(keyTy, nullptr, "key");
+  llvm::SmallVector<llvm::Value*, 8> args;
+  for (auto& arg : wrapper->args()) {
+    b.CreateStore(&arg, b.CreateConstInBoundsGEP2_32(keyTy, key, 0,
+                                                     args.size()));
+    args.push_back(&arg);
+  }
+  auto keyPtr = b.CreateConstInBoundsGEP2_32(keyTy, key, 0, 0);
+  auto cache = host(&c, cachePtrTy);
+
+  auto lookupTy = llvm::FunctionType::get(
+      doublePtrTy, {cachePtrTy, doublePtrTy}, false);
+  auto found = b.CreateCall(
+      lookupTy, hostFn(reinterpret_cast<const void*>(&lookupResult), lookupTy),
+      {cache, keyPtr});
+  b.CreateCondBr(b.CreateIsNotNull(found), hit, miss);
+
+  b.SetInsertPoint(hit);
+  b.CreateRet(b.CreateLoad(doubleTy, found));
+
+  b.SetInsertPoint(miss);
+  auto result = b.CreateCall(f.getFunctionType(), &f, args);
+  auto storeTy = llvm::FunctionType::get(
+      b.getVoidTy(), {cachePtrTy, doublePtrTy, doubleTy}, false);
+  b.CreateCall(storeTy,
+               hostFn(reinterpret_cast<const void*>(&storeResult), storeTy),
+               {cache, keyPtr, result});
+  b.CreateRet(result);
+  return wrapper;
+}
+
+}  // namespace memo
+}  // namespace kaso
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <llvm/IR/Function.h>
+#include <cstdint>
+#include <vector>
+#include "lexer/Symbol.h"
+
+namespace kaso {
+namespace memo {
+
+/// Results of a memoized definition keyed on the bits of its arguments, in
+/// an open-addressing table of fixed capacity. A key is looked for in a
+/// short run of slots after its hash; when the run is full the new result
+/// evicts the first one, so the table never grows.
+class Cache {
+ public:
+  static const size_t kDefaultCapacity = 1 << 16;
+  static const size_t kMaxProbe = 8;
+
+  /// capacity is rounded up to a power of two.
+  Cache(lexer::Symbol name, unsigned arity,
+        size_t capacity = kDefaultCapacity);
+
+  /// The result remembered for args, or nullptr.
+  const double* find(const double* args);
+
+  void insert(const double* args, double result);
+
+  /// Forgets every result, e.g. after a definition it calls changed.
+  void clear();
+
+  lexer::Symbol name() const { return name_; }
+  unsigned arity() const { return arity_; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return used_.size(); }
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+ private:
+  size_t home(const double* args) const;
+  bool matches(size_t slot, const double* args) const;
+
+  lexer::Symbol name_;
+  unsigned arity_;
+  size_t size_ = 0;
+  uint64_t hits_ = 0;
+  uint64_t misses_ = 0;
+  std::vector<double> keys_;  // arity_ per slot
+  std::vector<double> values_;
+  std::vector<bool> used_;
+};
+
+/// The cache of the definition name. Code holds its address, so caches live
+/// until exit; a definition with a new arity gets a new one.
+Cache& cacheFor(lexer::Symbol name, unsigned arity);
+
+/// The current cache of every memoized definition, oldest first.
+std::vector<const Cache*> caches();
+
+void clearAll();
+
+/// Renames f to "name.uncached" and emits a wrapper under its name that
+/// answers from c, or calls f and remembers the result. Every call to f,
+/// its own included, goes through the wrapper.
+llvm::Function* wrap(llvm::Function& f, Cache& c);
+
+}  // namespace memo
+}  // namespace kaso
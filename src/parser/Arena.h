@@ -0,0 +1,43 @@
+#pragma once
+
+#include <llvm/Support/Allocator.h>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+namespace kaso {
+namespace parser {
+
+/// Bump-pointer storage for the AST of one top-level item. Nodes never run
+/// destructors; everything is released at once when the arena goes away.
+class Arena {
+ public:
+  template <typename T, typename... Args>
+  T* make(Args&&... args) {
+    static_assert(std::is_trivially_destructible<T>::value,
+                  "arena objects are never destroyed");
+    auto mem = alloc_.Allocate(sizeof(T), alignof(T));
+    return new (mem) T(std::forward<Args>(args)...);
+  }
+
+  /// Copies n elements into the arena.
+  template <typename T>
+  T* copy(const T* src, size_t n) {
+    static_assert(std::is_trivially_copyable<T>::value,
+                  "arena arrays are copied bytewise");
+    if (n == 0) {
+      return nullptr;
+    }
+    auto mem = static_cast<T*>(alloc_.Allocate(sizeof(T) * n, alignof(T)));
+    std::memcpy(mem, src, sizeof(T) * n);
+    return mem;
+  }
+
+  size_t bytesAllocated() const { return alloc_.getBytesAllocated(); }
+
+ private:
+  llvm::BumpPtrAllocator alloc_;
+};
+
+}  // namespace parser
+}  // namespace kaso
@@ -0,0 +1,204 @@
+#include "parser/BatchParser.h"
+#include <llvm/Support/ThreadPool.h>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include "global/FastMath.h"
+#include "parser/Parser.h"
+
+namespace kaso {
+namespace parser {
+
+namespace {
+
+/// An operator defined by the item starting at token begin.
+struct OperatorDef {
+  size_t begin;
+  lexer::Token op;
+  bool binary;
+  uint32_t precedence;
+  lexer::Symbol fn;
+};
+
+void apply(OperatorTable& ops, const OperatorDef& def) {
+  if (def.binary) {
+    ops.defineBinary(def.op, def.precedence, def.fn);
+  } else {
+    ops.defineUnary(def.op, def.fn);
+  }
+}
+
+std::vector<OperatorDef> scanOperators(
+    const std::shared_ptr<const lexer::TokenBuffer>& tokens) {
+  std::vector<OperatorDef> defs;
+  auto& starts = tokens->itemStarts();
+  for (size_t i = 0; i != starts.size(); ++i) {
+    size_t begin = starts[i];
+    if (tokens->kind(begin) != lexer::Token::Def) {
+      continue;
+    }
+    size_t head = prototypeStart(*tokens, begin);
+    if (tokens->kind(head) != lexer::Token::Binary &&
+        tokens->kind(head) != lexer::Token::Unary) {
+      continue;
+    }
+    size_t end = i + 1 != starts.size() ? starts[i + 1] : tokens->size();
+    Parser par(tokens, head, end);
+    par.getNextToken();
+    auto proto = par.prototype();
+    if (proto != nullptr && (proto->isBinaryOp() || proto->isUnaryOp())) {
+      defs.push_back({begin, proto->getOperator(), proto->isBinaryOp(),
+                      proto->getBinOpPrecedence(), proto->getName()});
+    }
+  }
+  return defs;
+}
+
+/// The shell's read loop over tokens [begin, end).
+std::vector<ParsedItem> parseChunk(
+    const std::shared_ptr<const lexer::TokenBuffer>& tokens, size_t begin,
+    size_t end, const OperatorTable& ops,
+    const std::vector<OperatorDef>& defs) {
+  std::vector<ParsedItem> items;
+  Parser par(tokens, begin, end);
+  par.operators() = ops;
+  auto nextDef = std::lower_bound(
+      defs.begin(), defs.end(), begin,
+      [](const OperatorDef& d, size_t pos) { return d.begin < pos; });
+
+  par.getNextToken();
+  while (par.curToken() != lexer::Token::Eof) {
+    auto pos = par.tokenIndex();
+    for (; nextDef != defs.end() && nextDef->begin < pos; ++nextDef) {
+      apply(par.operators(), *nextDef);
+    }
+
+    switch (par.curToken()) {
+      case lexer::Token::Semicolon:
+        par.getNextToken();
+        break;
+      case lexer::Token::Def:
+        if (auto fn = par.definition()) {
+          items.push_back({ParsedItem::Kind::Definition, pos, std::move(fn)});
+        } else {
+          par.getNextToken();
+        }
+        break;
+      case lexer::Token::Extern:
+        if (auto proto = par.externDef()) {
+          items.push_back(
+              {ParsedItem::Kind::Extern, pos, nullptr, std::move(proto)});
+        } else {
+          par.getNextToken();
+        }
+        break;
+      case lexer::Token::Command:
+        items.push_back({ParsedItem::Kind::Command, pos});
+        par.getNextToken();
+        break;
+      default:
+        if (auto fn = par.topLevelExpr()) {
+          items.push_back({ParsedItem::Kind::Expression, pos, std::move(fn)});
+        } else {
+          par.getNextToken();
+        }
+        break;
+    }
+  }
+  return items;
+}
+
+}  // namespace
+
+size_t prototypeStart(const lexer::TokenBuffer& tokens, size_t def) {
+  static const auto memoName = lexer::intern("memo");
+  static const auto fastName = lexer::intern("fast");
+  auto head = def + 1;
+  while (head < tokens.size() &&
+         tokens.kind(head) == lexer::Token::Identifier) {
+    auto name = tokens.symVal(head);
+    if (name != memoName && name != fastName) {
+      break;
+    }
+    auto next = head + 1;
+    if (next == tokens.size() || tokens.kind(next) != lexer::Token::LeftParen) {
+      head = next;
+      continue;
+    }
+    // a parameter list of the function, unless it holds fast-math flags.
+    if (name == memoName) {
+      break;
+    }
+    auto close = next + 1;
+    auto flags = false;
+    for (; close < tokens.size() &&
+           tokens.kind(close) == lexer::Token::Identifier;
+         ++close) {
+      flags |= global::fastMathFlag(tokens.text(close)) != 0;
+    }
+    if (!flags) {
+      break;
+    }
+    head = close + 1;
+  }
+  return head;
+}
+
+std::vector<ParsedItem> parseBatch(
+    std::shared_ptr<const lexer::TokenBuffer> tokens, unsigned threads,
+    const OperatorTable& ops) {
+  if (threads == 0) {
+    threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  auto defs = scanOperators(tokens);
+
+  // a few chunks per thread of about the same number of tokens, cut at item
+  // starts, so that one slow chunk does not hold up the batch.
+  auto& starts = tokens->itemStarts();
+  size_t numChunks = std::min<size_t>(threads * 4, starts.size());
+  std::vector<size_t> cuts = {0};
+  for (size_t i = 1; i < numChunks; ++i) {
+    size_t target = tokens->size() * i / numChunks;
+    auto it = std::lower_bound(starts.begin(), starts.end(), target);
+    if (it != starts.end() && *it > cuts.back()) {
+      cuts.push_back(*it);
+    }
+  }
+  cuts.push_back(tokens->size());
+
+  // operator table each chunk starts from.
+  std::vector<OperatorTable> tables;
+  auto table = ops;
+  auto def = defs.begin();
+  for (size_t c = 0; c + 1 != cuts.size(); ++c) {
+    for (; def != defs.end() && def->begin < cuts[c]; ++def) {
+      apply(table, *def);
+    }
+    tables.push_back(table);
+  }
+
+  std::vector<std::vector<ParsedItem>> chunks(cuts.size() - 1);
+  auto parse = [&](size_t c) {
+    chunks[c] = parseChunk(tokens, cuts[c], cuts[c + 1], tables[c], defs);
+  };
+  if (threads == 1 || chunks.size() == 1) {
+    for (size_t c = 0; c != chunks.size(); ++c) {
+      parse(c);
+    }
+  } else {
+    llvm::ThreadPool pool(threads);
+    for (size_t c = 0; c != chunks.size(); ++c) {
+      pool.async(parse, c);
+    }
+    pool.wait();
+  }
+
+  std::vector<ParsedItem> items;
+  for (auto& chunk : chunks) {
+    std::move(chunk.begin(), chunk.end(), std::back_inserter(items));
+  }
+  return items;
+}
+
+}  // namespace parser
+}  // namespace kaso
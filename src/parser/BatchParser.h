@@ -0,0 +1,42 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "lexer/TokenBuffer.h"
+#include "parser/Function.h"
+#include "parser/OperatorTable.h"
+
+namespace kaso {
+namespace parser {
+
+/// One successfully parsed top-level item.
+struct ParsedItem {
+  enum class Kind { Definition, Extern, Expression, Command };
+
+  Kind kind;
+  size_t begin;                      // token index of the first token
+  std::unique_ptr<Function> fn;      // definitions and expressions
+  std::unique_ptr<Prototype> proto;  // externs
+};
+
+/// Index of the prototype of the 'def' at token def, past its annotations, see
+/// Parser::definition().
+size_t prototypeStart(const lexer::TokenBuffer& tokens, size_t def);
+
+/// Parses a whole token buffer on a thread pool and returns its items in
+/// source order, as the shell's read loop would have parsed them.
+///
+/// The buffer is cut into chunks at top-level item boundaries. A sequential
+/// pre-pass reads the prototype of every 'def binary'/'def unary', so each
+/// chunk starts from the operator table that all earlier items leave behind
+/// and applies the definitions inside it as its parse reaches them. An
+/// operator definition whose body later fails to compile therefore still
+/// counts as defined for the rest of the batch.
+///
+/// threads == 0 uses one thread per core.
+std::vector<ParsedItem> parseBatch(
+    std::shared_ptr<const lexer::TokenBuffer> tokens, unsigned threads = 0,
+    const OperatorTable& ops = OperatorTable());
+
+}  // namespace parser
+}  // namespace kaso
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <llvm/ADT/Optional.h>
+#include "lexer/Lexer.h"
+
+namespace kaso {
+namespace parser {
+
+/// What the builtin operators compute, shared by the simplifier and the
+/// interpreter so that both agree with the IR emitBinary() and emitLogic()
+/// produce. Comparisons give 1 or 0. '<', '>', '<=' and '>=' are also true
+/// when an operand is NaN (fcmp ult, ugt, ule, uge), '==' is not (oeq) and
+/// '!=' is (une). '&&' and '||' treat a value as true when it is ordered and
+/// not 0, like an if condition.
+
+/// Truth of a condition the way the IR tests it: fcmp one, so NaN is false.
+inline bool isTrue(double v) { return v < 0.0 || v > 0.0; }
+
+/// Whether op is '&&' or '||', which evaluate their right operand only if
+/// the left one does not decide the result.
+inline bool isLogic(lexer::Token op) {
+  return op == lexer::Token::OpLogicAnd || op == lexer::Token::OpLogicOr;
+}
+
+/// The builtin binary operator op applied to l and r, or None if op is no
+/// builtin.
+inline llvm::Optional<double> evalBinary(lexer::Token op, double l, double r) {
+  switch (op) {
+    case lexer::Token::OpAdd:
+      return l + r;
+    case lexer::Token::OpSub:
+      return l - r;
+    case lexer::Token::OpMul:
+      return l * r;
+    case lexer::Token::OpDiv:
+      return l / r;
+    case lexer::Token::OpLess:
+      return !(l >= r) ? 1.0 : 0.0;
+    case lexer::Token::OpGreat:
+      return !(l <= r) ? 1.0 : 0.0;
+    case lexer::Token::OpLE:
+      return !(l > r) ? 1.0 : 0.0;
+    case lexer::Token::OpGE:
+      return !(l < r) ? 1.0 : 0.0;
+    case lexer::Token::OpEQ:
+      return l == r ? 1.0 : 0.0;
+    case lexer::Token::OpNE:
+      return l != r ? 1.0 : 0.0;
+    case lexer::Token::OpLogicAnd:
+      return isTrue(l) && isTrue(r) ? 1.0 : 0.0;
+    case lexer::Token::OpLogicOr:
+      return isTrue(l) || isTrue(r) ? 1.0 : 0.0;
+    default:
+      return llvm::None;
+  }
+}
+
+}  // namespace parser
+}  // namespace kaso
@@ -0,0 +1,396 @@
+#include "parser/CodeGen.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/IR/Attributes.h>
+#include <llvm/IR/CFG.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include "global/FastMath.h"
+#include "global/Global.h"
+#include "global/MathLib.h"
+
+namespace kaso {
+namespace parser {
+
+llvm::Value* emitNumber(double val) {
+  return llvm::ConstantFP::get(global::gContext(), llvm::APFloat(val));
+}
+
+llvm::AllocaInst* emitLocal(lexer::Symbol name, llvm::Value* init) {
+  auto func = global::gBuilder().GetInsertBlock()->getParent();
+  auto& entry = func->getEntryBlock();
+  llvm::IRBuilder<> b(&entry, entry.begin());
+  auto slot = b.CreateAlloca(llvm::Type::getDoubleTy(global::gContext()),
+                             nullptr, lexer::symbolName(name));
+  global::gBuilder().CreateStore(init, slot);
+  return slot;
+}
+
+llvm::Value* emitVariable(lexer::Symbol name) {
+  auto v = global::gNamedValues()[name];
+  if (!v) {
+    return logErrorV("Unknown variable name");
+  }
+  if (auto slot = llvm::dyn_cast<llvm::AllocaInst>(v)) {
+    return global::gBuilder().CreateLoad(slot->getAllocatedType(), slot,
+                                         lexer::symbolName(name));
+  }
+  return v;
+}
+
+llvm::Value* emitAssign(lexer::Symbol name, llvm::Value* val) {
+  auto slot = llvm::dyn_cast_or_null<llvm::AllocaInst>(
+      global::gNamedValues().lookup(name));
+  if (slot == nullptr) {
+    return logErrorV("Unknown variable name");
+  }
+  global::gBuilder().CreateStore(val, slot);
+  return val;
+}
+
+llvm::Value* emitVar(llvm::ArrayRef<lexer::Symbol> names,
+                     llvm::function_ref<llvm::Value*(size_t)> init,
+                     EmitFn body) {
+  llvm::SmallVector<llvm::Value*, 4> oldVals;
+  for (size_t i = 0; i != names.size(); ++i) {
+    auto initVal = init(i);
+    if (initVal == nullptr) {
+      return nullptr;
+    }
+    oldVals.push_back(global::gNamedValues().lookup(names[i]));
+    global::gNamedValues()[names[i]] = emitLocal(names[i], initVal);
+  }
+
+  auto bodyVal = body();
+
+  // restore the unshadowed variables, last binding first.
+  for (size_t i = names.size(); i-- != 0;) {
+    if (oldVals[i]) {
+      global::gNamedValues()[names[i]] = oldVals[i];
+    } else {
+      global::gNamedValues().erase(names[i]);
+    }
+  }
+  return bodyVal;
+}
+
+llvm::Value* emitBinary(lexer::Token op, lexer::Symbol userFn, llvm::Value* l,
+                        llvm::Value* r) {
+  if (userFn != lexer::kNoSymbol) {
+    auto f = global::getCallee(userFn);
+    if (f == nullptr) {
+      return logErrorV("binary operator not found");
+    }
+    llvm::Value* args[] = {l, r};
+    return global::gBuilder().CreateCall(f, args, "binop");
+  }
+
+  auto& b = global::gBuilder();
+  auto predicate = llvm::CmpInst::BAD_FCMP_PREDICATE;
+  switch (op) {
+    case lexer::Token::OpAdd:
+      return b.CreateFAdd(l, r, "addtmp");
+    case lexer::Token::OpSub:
+      return b.CreateFSub(l, r, "subtmp");
+    case lexer::Token::OpMul:
+      return b.CreateFMul(l, r, "multmp");
+    case lexer::Token::OpDiv:
+      return b.CreateFDiv(l, r, "divtmp");
+    // see parser/Builtin.h for the NaN behaviour.
+    case lexer::Token::OpLess:
+      predicate = llvm::CmpInst::FCMP_ULT;
+      break;
+    case lexer::Token::OpGreat:
+      predicate = llvm::CmpInst::FCMP_UGT;
+      break;
+    case lexer::Token::OpLE:
+      predicate = llvm::CmpInst::FCMP_ULE;
+      break;
+    case lexer::Token::OpGE:
+      predicate = llvm::CmpInst::FCMP_UGE;
+      break;
+    case lexer::Token::OpEQ:
+      predicate = llvm::CmpInst::FCMP_OEQ;
+      break;
+    case lexer::Token::OpNE:
+      predicate = llvm::CmpInst::FCMP_UNE;
+      break;
+    default:
+      return logErrorV("invalid binary operator");
+  }
+  auto cmp = b.CreateFCmp(predicate, l, r, "cmptmp");
+  return b.CreateUIToFP(cmp, b.getDoubleTy(), "booltmp");
+}
+
+llvm::Value* emitLogic(lexer::Token op, EmitFn lhs, EmitFn rhs) {
+  auto& b = global::gBuilder();
+  auto zero = emitNumber(0.0);
+  auto l = lhs();
+  if (l == nullptr) {
+    return nullptr;
+  }
+  auto lCond = b.CreateFCmpONE(l, zero, "lhscond");
+  auto lhsBb = b.GetInsertBlock();
+
+  auto func = lhsBb->getParent();
+  auto rhsBb = llvm::BasicBlock::Create(global::gContext(), "rhs", func);
+  auto mergeBb = llvm::BasicBlock::Create(global::gContext(), "logiccont");
+  if (op == lexer::Token::OpLogicAnd) {
+    b.CreateCondBr(lCond, rhsBb, mergeBb);
+  } else {
+    b.CreateCondBr(lCond, mergeBb, rhsBb);
+  }
+
+  b.SetInsertPoint(rhsBb);
+  auto r = rhs();
+  if (r == nullptr) {
+    return nullptr;
+  }
+  auto rCond = b.CreateFCmpONE(r, zero, "rhscond");
+  b.CreateBr(mergeBb);
+  rhsBb = b.GetInsertBlock();
+
+  // the left operand decided the result if it skipped the right one.
+  func->getBasicBlockList().push_back(mergeBb);
+  b.SetInsertPoint(mergeBb);
+  auto phi = b.CreatePHI(b.getInt1Ty(), 2, "logictmp");
+  phi->addIncoming(b.getInt1(op == lexer::Token::OpLogicOr), lhsBb);
+  phi->addIncoming(rCond, rhsBb);
+  return b.CreateUIToFP(phi, b.getDoubleTy(), "booltmp");
+}
+
+llvm::Value* emitUnary(lexer::Symbol userFn, llvm::Value* v) {
+  if (userFn == lexer::kNoSymbol) {
+    return logErrorV("Unknown unary operator");
+  }
+
+  auto f = global::getCallee(userFn);
+  if (f == nullptr) {
+    return logErrorV("Unknown unary operator");
+  }
+
+  return global::gBuilder().CreateCall(f, v, "unop");
+}
+
+llvm::Function* emitCallee(lexer::Symbol callee, size_t numArgs) {
+  auto proto = global::getProto(callee);
+  if (proto != nullptr && proto->isExtern() &&
+      proto->getArgs().size() == numArgs) {
+    auto id = global::mathIntrinsic(lexer::symbolName(callee), numArgs);
+    if (id != llvm::Intrinsic::not_intrinsic) {
+      return llvm::Intrinsic::getDeclaration(
+          global::gModule().get(), id,
+          {llvm::Type::getDoubleTy(global::gContext())});
+    }
+  }
+
+  auto calleeF = global::getCallee(callee);
+  if (!calleeF) {
+    logErrorV("Unknown function referenced");
+    return nullptr;
+  }
+  if (calleeF->arg_size() != numArgs) {
+    logErrorV("Incorrect # arguments passed");
+    return nullptr;
+  }
+  return calleeF;
+}
+
+llvm::Value* emitCall(llvm::Function* callee,
+                      llvm::ArrayRef<llvm::Value*> args) {
+  return global::gBuilder().CreateCall(callee, args, "calltmp");
+}
+
+llvm::Value* emitIf(EmitFn cond, EmitFn then, EmitFn els) {
+  auto condV = cond();
+  if (condV == nullptr) {
+    return nullptr;
+  }
+
+  auto c = llvm::ConstantFP::get(global::gContext(), llvm::APFloat(0.0));
+  condV = global::gBuilder().CreateFCmpONE(condV, c, "ifcond");
+
+  auto func = global::gBuilder().GetInsertBlock()->getParent();
+  auto thenBb = llvm::BasicBlock::Create(global::gContext(), "then", func);
+  auto elseBb = llvm::BasicBlock::Create(global::gContext(), "else");
+  auto mergeBb = llvm::BasicBlock::Create(global::gContext(), "ifcont");
+  global::gBuilder().CreateCondBr(condV, thenBb, elseBb);
+
+  // emit then value
+  global::gBuilder().SetInsertPoint(thenBb);
+  auto thenV = then();
+  if (thenV == nullptr) {
+    return nullptr;
+  }
+
+  global::gBuilder().CreateBr(mergeBb);
+  thenBb = global::gBuilder().GetInsertBlock();
+
+  // emit the else block.
+  func->getBasicBlockList().push_back(elseBb);
+  global::gBuilder().SetInsertPoint(elseBb);
+  auto elseV = els();
+  if (elseV == nullptr) {
+    return nullptr;
+  }
+
+  global::gBuilder().CreateBr(mergeBb);
+  elseBb = global::gBuilder().GetInsertBlock();
+
+  // emit the merge block.
+  func->getBasicBlockList().push_back(mergeBb);
+  global::gBuilder().SetInsertPoint(mergeBb);
+  auto type = llvm::Type::getDoubleTy(global::gContext());
+  auto phiNode = global::gBuilder().CreatePHI(type, 2, "iftmp");
+  phiNode->addIncoming(thenV, thenBb);
+  phiNode->addIncoming(elseV, elseBb);
+
+  return phiNode;
+}
+
+llvm::Value* emitFor(lexer::Symbol varName, EmitFn start, EmitFn end,
+                     EmitFn step, EmitFn body) {
+  auto startVal = start();
+  if (startVal == nullptr) {
+    return nullptr;
+  }
+
+  auto func = global::gBuilder().GetInsertBlock()->getParent();
+  auto slot = emitLocal(varName, startVal);
+  auto loopBb = llvm::BasicBlock::Create(global::gContext(), "loop", func);
+  global::gBuilder().CreateBr(loopBb);
+
+  // start insertion in loopBb.
+  global::gBuilder().SetInsertPoint(loopBb);
+
+  auto oldVal = global::gNamedValues()[varName];
+  global::gNamedValues()[varName] = slot;
+
+  // emit the body of the loop.
+  if (body() == nullptr) {
+    return nullptr;
+  }
+
+  // emit the step value.
+  auto stepVal = step();
+  if (stepVal == nullptr) {
+    return nullptr;
+  }
+
+  auto endCond = end();
+  if (endCond == nullptr) {
+    return nullptr;
+  }
+
+  // the body may have assigned the variable.
+  auto type = llvm::Type::getDoubleTy(global::gContext());
+  auto curVar =
+      global::gBuilder().CreateLoad(type, slot, lexer::symbolName(varName));
+  auto nextVar = global::gBuilder().CreateFAdd(curVar, stepVal, "nextvar");
+  global::gBuilder().CreateStore(nextVar, slot);
+
+  auto cons = llvm::ConstantFP::get(global::gContext(), llvm::APFloat(0.0));
+  endCond = global::gBuilder().CreateFCmpONE(endCond, cons, "loopcond");
+
+  auto afterBb =
+      llvm::BasicBlock::Create(global::gContext(), "afterloop", func);
+
+  global::gBuilder().CreateCondBr(endCond, loopBb, afterBb);
+
+  global::gBuilder().SetInsertPoint(afterBb);
+
+  // restore the unshadowed variable.
+  if (oldVal) {
+    global::gNamedValues()[varName] = oldVal;
+  } else {
+    global::gNamedValues().erase(varName);
+  }
+
+  // for expr always returns 0.0.
+  return llvm::Constant::getNullValue(type);
+}
+
+void emitTailReturns(llvm::Function& f) {
+  llvm::SmallVector<llvm::ReturnInst*, 8> work;
+  for (auto& bb : f) {
+    if (auto ret = llvm::dyn_cast<llvm::ReturnInst>(bb.getTerminator())) {
+      work.push_back(ret);
+    }
+  }
+
+  while (!work.empty()) {
+    auto ret = work.pop_back_val();
+    auto value = ret->getReturnValue();
+    auto call = llvm::dyn_cast<llvm::CallInst>(value);
+    if (call != nullptr && call->getNextNode() == ret) {
+      call->setTailCall();
+      continue;
+    }
+
+    // ret of a phi alone in its block: return the calls and the nested phis
+    // it merges straight from the branches that compute them.
+    auto phi = llvm::dyn_cast<llvm::PHINode>(value);
+    auto bb = ret->getParent();
+    if (phi == nullptr || phi->getNextNode() != ret || &bb->front() != phi) {
+      continue;
+    }
+    for (auto i = phi->getNumIncomingValues(); i-- != 0;) {
+      auto in = phi->getIncomingValue(i);
+      auto pred = phi->getIncomingBlock(i);
+      auto br = llvm::dyn_cast<llvm::BranchInst>(pred->getTerminator());
+      auto inst = llvm::dyn_cast<llvm::Instruction>(in);
+      auto tail = llvm::isa<llvm::CallInst>(in) || llvm::isa<llvm::PHINode>(in);
+      if (br == nullptr || br->isConditional() || !tail ||
+          inst->getNextNode() != br) {
+        continue;
+      }
+      br->eraseFromParent();
+      work.push_back(llvm::ReturnInst::Create(global::gContext(), in, pred));
+      phi->removeIncomingValue(i, false);
+    }
+    if (llvm::pred_empty(bb)) {
+      bb->eraseFromParent();
+    }
+  }
+}
+
+void inlineImported(llvm::Function& f) {
+  llvm::SmallVector<llvm::CallInst*, 8> calls;
+  for (auto& bb : f) {
+    for (auto& inst : bb) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+      auto callee = call != nullptr ? call->getCalledFunction() : nullptr;
+      if (callee != nullptr && callee != &f &&
+          callee->hasAvailableExternallyLinkage()) {
+        calls.push_back(call);
+      }
+    }
+  }
+  // calls the inlined bodies bring along are left alone, so a recursive
+  // callee is inlined once. f takes on the callee's attributes the way the
+  // inliner pass does it.
+  for (auto call : calls) {
+    llvm::AttributeFuncs::mergeAttributesForInlining(
+        f, *call->getCalledFunction());
+    global::mergeFastMathAttributes(f, *call->getCalledFunction());
+    llvm::InlineFunctionInfo ifi;
+    llvm::InlineFunction(call, ifi);
+  }
+}
+
+void requireTailCalls(llvm::Function& f) {
+  for (auto& bb : f) {
+    auto ret = llvm::dyn_cast<llvm::ReturnInst>(bb.getTerminator());
+    if (ret == nullptr) {
+      continue;
+    }
+    auto call = llvm::dyn_cast_or_null<llvm::CallInst>(ret->getPrevNode());
+    if (call != nullptr && call->isTailCall() &&
+        ret->getReturnValue() == call &&
+        call->getFunctionType() == f.getFunctionType()) {
+      call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+    }
+  }
+}
+
+}  // namespace parser
+}  // namespace kaso
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/Value.h>
+#include "lexer/Lexer.h"
+
+namespace kaso {
+namespace parser {
+
+/// IR lowering shared by the tree (Expr) and flat (FlatExpr) ASTs, so that
+/// both produce the same code. Operands are emitted by the caller; control
+/// flow helpers take callbacks that emit a sub-expression at the current
+/// insert point. Every helper logs and returns null on failure.
+using EmitFn = llvm::function_ref<llvm::Value*()>;
+
+llvm::Value* emitNumber(double val);
+
+/// Mutable variables live in entry-block allocas that mem2reg promotes back
+/// to SSA values. Returns one holding init; the caller binds name to it.
+llvm::AllocaInst* emitLocal(lexer::Symbol name, llvm::Value* init);
+
+/// Loads name if it is an alloca, otherwise uses the value bound directly.
+llvm::Value* emitVariable(lexer::Symbol name);
+
+/// Stores val to the alloca bound to name and returns val.
+llvm::Value* emitAssign(lexer::Symbol name, llvm::Value* val);
+
+/// Binds each of names to a new local holding init(i), in turn, while the
+/// later inits and body are emitted.
+llvm::Value* emitVar(llvm::ArrayRef<lexer::Symbol> names,
+                     llvm::function_ref<llvm::Value*(size_t)> init,
+                     EmitFn body);
+
+/// userFn is the user-defined operator function, or kNoSymbol for a builtin.
+llvm::Value* emitBinary(lexer::Token op, lexer::Symbol userFn, llvm::Value* l,
+                        llvm::Value* r);
+
+/// The builtin '&&' or '||': emits rhs only when lhs does not decide the
+/// result, which is 1 or 0.
+llvm::Value* emitLogic(lexer::Token op, EmitFn lhs, EmitFn rhs);
+
+llvm::Value* emitUnary(lexer::Symbol userFn, llvm::Value* v);
+
+/// Resolves a callee and checks that it takes numArgs arguments. An extern
+/// of the C math library resolves to its intrinsic.
+llvm::Function* emitCallee(lexer::Symbol callee, size_t numArgs);
+
+llvm::Value* emitCall(llvm::Function* callee,
+                      llvm::ArrayRef<llvm::Value*> args);
+
+llvm::Value* emitIf(EmitFn cond, EmitFn then, EmitFn els);
+
+/// Binds varName to the loop variable while body, step and end are emitted.
+llvm::Value* emitFor(lexer::Symbol varName, EmitFn start, EmitFn end,
+                     EmitFn step, EmitFn body);
+
+/// Puts the calls an if leaves in tail position in tail position in the IR
+/// too, by returning from each branch instead of through the merge phi, and
+/// marks every call right before a ret as a tail call. Run before the pass
+/// pipeline, so tail recursion elimination can turn self calls into loops.
+void emitTailReturns(llvm::Function& f);
+
+/// Inlines the calls in f to bodies imported by global::getCallee(), before
+/// the pass pipeline cleans up after them.
+void inlineImported(llvm::Function& f);
+
+/// Upgrades the tail calls left after optimization to musttail where the
+/// callee has the caller's type, so the backend has to emit a jump.
+void requireTailCalls(llvm::Function& f);
+
+}  // namespace parser
+}  // namespace kaso
@@ -1,22 +1,46 @@
 #pragma once
 
 #include <llvm/IR/Value.h>
-#include <utility>
-#include <vector>
+#include <cstdint>
 #include "lexer/Lexer.h"
 
 namespace kaso {
 namespace parser {
 
+/// AST nodes live in the Arena of the top-level item they belong to. They
+/// refer to each other with plain pointers, hold no owning members and are
+/// never destroyed individually.
 class Expr {
  public:
-  virtual ~Expr() = default;
+  enum class Kind : uint8_t {
+    Number,
+    Variable,
+    Binary,
+    Call,
+    If,
+    For,
+    Unary,
+    Var,
+    Assign
+  };
+
+  explicit Expr(Kind kind) : kind_(kind) {}
+
+  Kind kind() const { return kind_; }
+
   virtual llvm::Value* codeGen() = 0;
+
+ private:
+  Kind kind_;
 };
 
 class NumberExpr : public Expr {
  public:
-  explicit NumberExpr(double val) : val_(val) {}
+  explicit NumberExpr(double val) : Expr(Kind::Number), val_(val) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::Number; }
+
+  double getVal() const { return val_; }
 
   llvm::Value* codeGen() override;
 
@@ -26,99 +50,190 @@ class NumberExpr : public Expr {
 
 class VariableExpr : public Expr {
  public:
-  explicit VariableExpr(std::string name) : name_(std::move(name)) {}
+  explicit VariableExpr(lexer::Symbol name)
+      : Expr(Kind::Variable), name_(name) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::Variable; }
+
+  lexer::Symbol getName() const { return name_; }
 
   llvm::Value* codeGen() override;
 
  private:
-  std::string name_;
+  lexer::Symbol name_;
 };
 
 class BinaryExpr : public Expr {
  public:
-  BinaryExpr(lexer::Token op, std::string opStr, std::unique_ptr<Expr> lhs,
-             std::unique_ptr<Expr> rhs)
-      : op_(op),
-        opStr_(std::move(opStr)),
-        lhs_(std::move(lhs)),
-        rhs_(std::move(rhs)) {}
+  /// userFn is the function implementing a user-defined operator, or
+  /// kNoSymbol to emit the builtin instruction.
+  BinaryExpr(lexer::Token op, Expr* lhs, Expr* rhs,
+             lexer::Symbol userFn = lexer::kNoSymbol)
+      : Expr(Kind::Binary), op_(op), userFn_(userFn), lhs_(lhs), rhs_(rhs) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::Binary; }
+
+  lexer::Token getOp() const { return op_; }
+  lexer::Symbol getUserFn() const { return userFn_; }
+  Expr* getLHS() const { return lhs_; }
+  Expr* getRHS() const { return rhs_; }
 
   llvm::Value* codeGen() override;
 
  private:
   lexer::Token op_;
-  std::string opStr_;
-  std::unique_ptr<Expr> lhs_, rhs_;
+  lexer::Symbol userFn_;
+  Expr *lhs_, *rhs_;
 };
 
 class CallExpr : public Expr {
  public:
-  CallExpr(std::string callee, std::vector<std::unique_ptr<Expr>> args)
-      : callee_(std::move(callee)), args_(std::move(args)) {}
+  /// args points to numArgs arguments allocated in the same arena.
+  CallExpr(lexer::Symbol callee, Expr* const* args, uint32_t numArgs)
+      : Expr(Kind::Call), callee_(callee), numArgs_(numArgs), args_(args) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::Call; }
+
+  lexer::Symbol getCallee() const { return callee_; }
+  uint32_t getNumArgs() const { return numArgs_; }
+  Expr* getArg(uint32_t i) const { return args_[i]; }
 
   llvm::Value* codeGen() override;
 
  private:
-  std::string callee_;
-  std::vector<std::unique_ptr<Expr>> args_;
+  lexer::Symbol callee_;
+  uint32_t numArgs_;
+  Expr* const* args_;
 };
 
 class IfExpr : public Expr {
  public:
-  IfExpr(std::unique_ptr<Expr> cond, std::unique_ptr<Expr> then,
-         std::unique_ptr<Expr> els)
-      : cond_(std::move(cond)), then_(std::move(then)), else_(std::move(els)) {}
+  IfExpr(Expr* cond, Expr* then, Expr* els)
+      : Expr(Kind::If), cond_(cond), then_(then), else_(els) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::If; }
+
+  Expr* getCond() const { return cond_; }
+  Expr* getThen() const { return then_; }
+  Expr* getElse() const { return else_; }
 
   llvm::Value* codeGen() override;
 
  private:
-  std::unique_ptr<Expr> cond_, then_, else_;
+  Expr *cond_, *then_, *else_;
 };
 
 class ForExpr : public Expr {
  public:
-  ForExpr(std::string varName, std::unique_ptr<Expr> start,
-          std::unique_ptr<Expr> end, std::unique_ptr<Expr> step,
-          std::unique_ptr<Expr> body)
-      : varName_(std::move(varName)),
-        start_(std::move(start)),
-        end_(std::move(end)),
-        step_(std::move(step)),
-        body_(std::move(body)){};
+  /// step may be null, meaning 1.0.
+  ForExpr(lexer::Symbol varName, Expr* start, Expr* end, Expr* step,
+          Expr* body)
+      : Expr(Kind::For),
+        varName_(varName),
+        start_(start),
+        end_(end),
+        step_(step),
+        body_(body) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::For; }
+
+  lexer::Symbol getVarName() const { return varName_; }
+  Expr* getStart() const { return start_; }
+  Expr* getEnd() const { return end_; }
+  Expr* getStep() const { return step_; }
+  Expr* getBody() const { return body_; }
 
   // Output for-loop as:
+  //   var = alloca double
   //   ...
   //   start = startexpr
+  //   store start -> var
   //   goto loop
   // loop:
-  //   variable = phi [start, loopheader], [nextvariable, loopend]
   //   ...
   //   bodyexpr
   //   ...
   // loopend:
   //   step = stepexpr
-  //   nextvariable = variable + step
   //   endcond = endexpr
+  //   curvar = load var
+  //   nextvar = curvar + step
+  //   store nextvar -> var
   //   br endcond, loop, endloop
   // outloop:
   llvm::Value* codeGen() override;
 
  private:
-  std::string varName_;
-  std::unique_ptr<Expr> start_, end_, step_, body_;
+  lexer::Symbol varName_;
+  Expr *start_, *end_, *step_, *body_;
 };
 
 class UnaryExpr : public Expr {
  public:
-  UnaryExpr(lexer::Token op, std::string opStr, std::unique_ptr<Expr> operand)
-      : op_(op), opStr_(std::move(opStr)), operand_(std::move(operand)) {}
+  UnaryExpr(lexer::Token op, Expr* operand,
+            lexer::Symbol userFn = lexer::kNoSymbol)
+      : Expr(Kind::Unary), op_(op), userFn_(userFn), operand_(operand) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::Unary; }
+
+  lexer::Token getOp() const { return op_; }
+  lexer::Symbol getUserFn() const { return userFn_; }
+  Expr* getOperand() const { return operand_; }
 
   llvm::Value* codeGen() override;
 
  private:
   lexer::Token op_;
-  std::string opStr_;
-  std::unique_ptr<Expr> operand_;
+  lexer::Symbol userFn_;
+  Expr* operand_;
+};
+
+/// var a = 1, b in body: binds each name in turn, to its init or 0.0, for
+/// the inits after it and the body.
+class VarExpr : public Expr {
+ public:
+  /// names and inits point to numVars entries in the same arena. An init may
+  /// be null.
+  VarExpr(const lexer::Symbol* names, Expr* const* inits, uint32_t numVars,
+          Expr* body)
+      : Expr(Kind::Var),
+        numVars_(numVars),
+        names_(names),
+        inits_(inits),
+        body_(body) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::Var; }
+
+  uint32_t getNumVars() const { return numVars_; }
+  lexer::Symbol getVarName(uint32_t i) const { return names_[i]; }
+  Expr* getInit(uint32_t i) const { return inits_[i]; }
+  Expr* getBody() const { return body_; }
+
+  llvm::Value* codeGen() override;
+
+ private:
+  uint32_t numVars_;
+  const lexer::Symbol* names_;
+  Expr* const* inits_;
+  Expr* body_;
+};
+
+/// varName = value, which is also the result.
+class AssignExpr : public Expr {
+ public:
+  AssignExpr(lexer::Symbol varName, Expr* value)
+      : Expr(Kind::Assign), varName_(varName), value_(value) {}
+
+  static bool classof(const Expr* e) { return e->kind() == Kind::Assign; }
+
+  lexer::Symbol getVarName() const { return varName_; }
+  Expr* getValue() const { return value_; }
+
+  llvm::Value* codeGen() override;
+
+ private:
+  lexer::Symbol varName_;
+  Expr* value_;
 };
 
 }  // namespace parser
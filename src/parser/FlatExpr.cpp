@@ -0,0 +1,308 @@
+#include "parser/FlatExpr.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Casting.h>
+#include <algorithm>
+#include <cassert>
+#include "parser/Builtin.h"
+#include "parser/CodeGen.h"
+
+namespace kaso {
+namespace parser {
+
+namespace {
+
+FlatExpr::Index flattenInto(FlatExpr& f, const Expr& e) {
+  switch (e.kind()) {
+    case Expr::Kind::Number:
+      return f.number(llvm::cast<NumberExpr>(e).getVal());
+    case Expr::Kind::Variable:
+      return f.variable(llvm::cast<VariableExpr>(e).getName());
+    case Expr::Kind::Binary: {
+      auto& b = llvm::cast<BinaryExpr>(e);
+      auto l = flattenInto(f, *b.getLHS());
+      auto r = flattenInto(f, *b.getRHS());
+      return f.binary(b.getOp(), l, r, b.getUserFn());
+    }
+    case Expr::Kind::Unary: {
+      auto& u = llvm::cast<UnaryExpr>(e);
+      auto v = flattenInto(f, *u.getOperand());
+      return f.unary(u.getOp(), v, u.getUserFn());
+    }
+    case Expr::Kind::Call: {
+      auto& c = llvm::cast<CallExpr>(e);
+      llvm::SmallVector<FlatExpr::Index, 8> args;
+      for (uint32_t i = 0; i != c.getNumArgs(); ++i) {
+        args.push_back(flattenInto(f, *c.getArg(i)));
+      }
+      return f.call(c.getCallee(), args);
+    }
+    case Expr::Kind::If: {
+      auto& i = llvm::cast<IfExpr>(e);
+      auto cond = flattenInto(f, *i.getCond());
+      auto then = flattenInto(f, *i.getThen());
+      auto els = flattenInto(f, *i.getElse());
+      return f.ifExpr(cond, then, els);
+    }
+    case Expr::Kind::For: {
+      auto& l = llvm::cast<ForExpr>(e);
+      auto start = flattenInto(f, *l.getStart());
+      auto end = flattenInto(f, *l.getEnd());
+      auto step = FlatExpr::kNone;
+      if (l.getStep() != nullptr) {
+        step = flattenInto(f, *l.getStep());
+      }
+      auto body = flattenInto(f, *l.getBody());
+      return f.forExpr(l.getVarName(), start, end, step, body);
+    }
+    case Expr::Kind::Var: {
+      auto& v = llvm::cast<VarExpr>(e);
+      llvm::SmallVector<lexer::Symbol, 4> names;
+      llvm::SmallVector<FlatExpr::Index, 4> inits;
+      for (uint32_t i = 0; i != v.getNumVars(); ++i) {
+        names.push_back(v.getVarName(i));
+        inits.push_back(v.getInit(i) != nullptr
+                            ? flattenInto(f, *v.getInit(i))
+                            : FlatExpr::kNone);
+      }
+      auto body = flattenInto(f, *v.getBody());
+      return f.varExpr(names, inits, body);
+    }
+    case Expr::Kind::Assign: {
+      auto& a = llvm::cast<AssignExpr>(e);
+      auto value = flattenInto(f, *a.getValue());
+      return f.assign(a.getVarName(), value);
+    }
+  }
+  llvm_unreachable("unknown expression kind");
+}
+
+FlatExpr::Node makeNode(Expr::Kind kind) {
+  FlatExpr::Node n;
+  n.kind = kind;
+  n.control = kind == Expr::Kind::If || kind == Expr::Kind::For ||
+              kind == Expr::Kind::Var;
+  n.op = lexer::Token::Error;
+  n.first = 0;
+  n.sym = lexer::kNoSymbol;
+  std::fill(std::begin(n.kids), std::end(n.kids), FlatExpr::kNone);
+  n.val = 0;
+  return n;
+}
+
+}  // namespace
+
+const FlatExpr::Index FlatExpr::kNone;
+
+FlatExpr FlatExpr::flatten(const Expr& root) {
+  FlatExpr f;
+  flattenInto(f, root);
+  return f;
+}
+
+FlatExpr::Index FlatExpr::add(Node node, llvm::ArrayRef<Index> kids) {
+  auto self = static_cast<Index>(nodes_.size());
+  node.first = kids.empty() ? self : nodes_[kids.front()].first;
+  auto next = node.first;
+  for (auto k : kids) {
+    assert(nodes_[k].first == next && "children must be adjacent subtrees");
+    node.control |= nodes_[k].control;
+    next = k + 1;
+  }
+  assert(next == self && "children must end right before their parent");
+  (void)next;
+  nodes_.push_back(node);
+  return self;
+}
+
+FlatExpr::Index FlatExpr::number(double val) {
+  auto n = makeNode(Expr::Kind::Number);
+  n.val = val;
+  return add(n, {});
+}
+
+FlatExpr::Index FlatExpr::variable(lexer::Symbol name) {
+  auto n = makeNode(Expr::Kind::Variable);
+  n.sym = name;
+  return add(n, {});
+}
+
+FlatExpr::Index FlatExpr::binary(lexer::Token op, Index lhs, Index rhs,
+                                 lexer::Symbol userFn) {
+  auto n = makeNode(Expr::Kind::Binary);
+  n.op = op;
+  n.sym = userFn;
+  n.kids[0] = lhs;
+  n.kids[1] = rhs;
+  // the right operand may be skipped.
+  n.control = userFn == lexer::kNoSymbol && isLogic(op);
+  return add(n, {lhs, rhs});
+}
+
+FlatExpr::Index FlatExpr::unary(lexer::Token op, Index operand,
+                                lexer::Symbol userFn) {
+  auto n = makeNode(Expr::Kind::Unary);
+  n.op = op;
+  n.sym = userFn;
+  n.kids[0] = operand;
+  return add(n, {operand});
+}
+
+FlatExpr::Index FlatExpr::call(lexer::Symbol callee,
+                               llvm::ArrayRef<Index> args) {
+  auto n = makeNode(Expr::Kind::Call);
+  n.sym = callee;
+  n.kids[0] = static_cast<Index>(args_.size());
+  n.kids[1] = static_cast<Index>(args.size());
+  args_.insert(args_.end(), args.begin(), args.end());
+  return add(n, args);
+}
+
+FlatExpr::Index FlatExpr::ifExpr(Index cond, Index then, Index els) {
+  auto n = makeNode(Expr::Kind::If);
+  n.kids[0] = cond;
+  n.kids[1] = then;
+  n.kids[2] = els;
+  return add(n, {cond, then, els});
+}
+
+FlatExpr::Index FlatExpr::forExpr(lexer::Symbol varName, Index start,
+                                  Index end, Index step, Index body) {
+  auto n = makeNode(Expr::Kind::For);
+  n.sym = varName;
+  n.kids[0] = start;
+  n.kids[1] = end;
+  n.kids[2] = step;
+  n.kids[3] = body;
+  if (step == kNone) {
+    return add(n, {start, end, body});
+  }
+  return add(n, {start, end, step, body});
+}
+
+FlatExpr::Index FlatExpr::varExpr(llvm::ArrayRef<lexer::Symbol> names,
+                                  llvm::ArrayRef<Index> inits, Index body) {
+  auto n = makeNode(Expr::Kind::Var);
+  n.kids[0] = static_cast<Index>(varNames_.size());
+  n.kids[1] = static_cast<Index>(names.size());
+  n.kids[2] = body;
+  varNames_.insert(varNames_.end(), names.begin(), names.end());
+  varInits_.insert(varInits_.end(), inits.begin(), inits.end());
+  llvm::SmallVector<Index, 8> kids;
+  for (auto init : inits) {
+    if (init != kNone) {
+      kids.push_back(init);
+    }
+  }
+  kids.push_back(body);
+  return add(n, kids);
+}
+
+FlatExpr::Index FlatExpr::assign(lexer::Symbol varName, Index value) {
+  auto n = makeNode(Expr::Kind::Assign);
+  n.sym = varName;
+  n.kids[0] = value;
+  return add(n, {value});
+}
+
+llvm::ArrayRef<FlatExpr::Index> FlatExpr::args(const Node& call) const {
+  return llvm::makeArrayRef(args_).slice(call.kids[0], call.kids[1]);
+}
+
+llvm::ArrayRef<lexer::Symbol> FlatExpr::varNames(const Node& var) const {
+  return llvm::makeArrayRef(varNames_).slice(var.kids[0], var.kids[1]);
+}
+
+llvm::ArrayRef<FlatExpr::Index> FlatExpr::varInits(const Node& var) const {
+  return llvm::makeArrayRef(varInits_).slice(var.kids[0], var.kids[1]);
+}
+
+llvm::Value* FlatExpr::codeGen() const {
+  std::vector<llvm::Value*> vals(nodes_.size());
+  return emit(root(), vals);
+}
+
+llvm::Value* FlatExpr::emit(Index i, std::vector<llvm::Value*>& vals) const {
+  auto& n = nodes_[i];
+  if (!n.control) {
+    // straight-line code: children always precede their parent.
+    for (auto j = n.first; j <= i; ++j) {
+      vals[j] = lower(nodes_[j], vals);
+      if (vals[j] == nullptr) {
+        return nullptr;
+      }
+    }
+    return vals[i];
+  }
+
+  auto emitKid = [&](Index k) { return [&, k] { return emit(k, vals); }; };
+  if (n.kind == Expr::Kind::Binary && n.sym == lexer::kNoSymbol &&
+      isLogic(n.op)) {
+    return vals[i] = emitLogic(n.op, emitKid(n.kids[0]), emitKid(n.kids[1]));
+  }
+  switch (n.kind) {
+    case Expr::Kind::If:
+      return vals[i] = emitIf(emitKid(n.kids[0]), emitKid(n.kids[1]),
+                              emitKid(n.kids[2]));
+    case Expr::Kind::For: {
+      auto step = [&] {
+        return n.kids[2] != kNone ? emit(n.kids[2], vals) : emitNumber(1.0);
+      };
+      return vals[i] = emitFor(n.sym, emitKid(n.kids[0]), emitKid(n.kids[1]),
+                               step, emitKid(n.kids[3]));
+    }
+    case Expr::Kind::Var: {
+      auto inits = varInits(n);
+      auto init = [&](size_t j) {
+        return inits[j] != kNone ? emit(inits[j], vals) : emitNumber(0.0);
+      };
+      return vals[i] = emitVar(varNames(n), init, emitKid(n.kids[2]));
+    }
+    case Expr::Kind::Call:
+      for (auto k : args(n)) {
+        if (emit(k, vals) == nullptr) {
+          return nullptr;
+        }
+      }
+      break;
+    default:
+      for (auto k : n.kids) {
+        if (k != kNone && emit(k, vals) == nullptr) {
+          return nullptr;
+        }
+      }
+      break;
+  }
+  return vals[i] = lower(n, vals);
+}
+
+llvm::Value* FlatExpr::lower(const Node& n,
+                             std::vector<llvm::Value*>& vals) const {
+  switch (n.kind) {
+    case Expr::Kind::Number:
+      return emitNumber(n.val);
+    case Expr::Kind::Variable:
+      return emitVariable(n.sym);
+    case Expr::Kind::Binary:
+      return emitBinary(n.op, n.sym, vals[n.kids[0]], vals[n.kids[1]]);
+    case Expr::Kind::Unary:
+      return emitUnary(n.sym, vals[n.kids[0]]);
+    case Expr::Kind::Call: {
+      auto callee = emitCallee(n.sym, n.kids[1]);
+      if (callee == nullptr) {
+        return nullptr;
+      }
+      llvm::SmallVector<llvm::Value*, 8> argsV;
+      for (auto k : args(n)) {
+        argsV.push_back(vals[k]);
+      }
+      return emitCall(callee, argsV);
+    }
+    case Expr::Kind::Assign:
+      return emitAssign(n.sym, vals[n.kids[0]]);
+    default:
+      llvm_unreachable("control flow is emitted by emit()");
+  }
+}
+
+}  // namespace parser
+}  // namespace kaso
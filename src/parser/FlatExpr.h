@@ -0,0 +1,81 @@
+#pragma once
+
+#include <llvm/ADT/ArrayRef.h>
+#include <llvm/IR/Value.h>
+#include <cstdint>
+#include <vector>
+#include "lexer/Lexer.h"
+#include "parser/Expr.h"
+
+namespace kaso {
+namespace parser {
+
+/// An expression tree stored in post-order in one array. Children come before
+/// their parent and are referred to by 32-bit index, the root is the last
+/// node, and every subtree occupies the contiguous range [first, index].
+///
+/// Codegen emits a subtree without if/for/var as one linear sweep over its
+/// range and only recurses where a child has to land in a block or scope of
+/// its own.
+class FlatExpr {
+ public:
+  using Index = uint32_t;
+  static const Index kNone = ~0u;
+
+  struct Node {
+    Expr::Kind kind;
+    bool control;        // the subtree contains an if, a for, a var, && or ||
+    lexer::Token op;     // binary and unary
+    Index first;         // first node of this subtree
+    lexer::Symbol sym;   // variable, callee, loop variable or operator fn
+    Index kids[4];       // call, var: offset and count in their arrays
+    double val;          // number
+  };
+
+  /// Converts a tree built by the parser.
+  static FlatExpr flatten(const Expr& root);
+
+  /// Builders append one node and return its index. The children passed in
+  /// must be the subtrees completed just before, in evaluation order.
+  Index number(double val);
+  Index variable(lexer::Symbol name);
+  Index binary(lexer::Token op, Index lhs, Index rhs,
+               lexer::Symbol userFn = lexer::kNoSymbol);
+  Index unary(lexer::Token op, Index operand,
+              lexer::Symbol userFn = lexer::kNoSymbol);
+  Index call(lexer::Symbol callee, llvm::ArrayRef<Index> args);
+  Index ifExpr(Index cond, Index then, Index els);
+  /// step may be kNone, meaning 1.0.
+  Index forExpr(lexer::Symbol varName, Index start, Index end, Index step,
+                Index body);
+  /// inits may hold kNone, meaning 0.0.
+  Index varExpr(llvm::ArrayRef<lexer::Symbol> names,
+                llvm::ArrayRef<Index> inits, Index body);
+  Index assign(lexer::Symbol varName, Index value);
+
+  size_t size() const { return nodes_.size(); }
+  Index root() const { return static_cast<Index>(nodes_.size() - 1); }
+  const Node& operator[](Index i) const { return nodes_[i]; }
+  /// Argument node indices of a call.
+  llvm::ArrayRef<Index> args(const Node& call) const;
+  /// Names and init node indices of a var.
+  llvm::ArrayRef<lexer::Symbol> varNames(const Node& var) const;
+  llvm::ArrayRef<Index> varInits(const Node& var) const;
+
+  /// Emits the same IR as root's Expr::codeGen.
+  llvm::Value* codeGen() const;
+
+ private:
+  Index add(Node node, llvm::ArrayRef<Index> kids);
+
+  llvm::Value* emit(Index i, std::vector<llvm::Value*>& vals) const;
+  llvm::Value* lower(const Node& n, std::vector<llvm::Value*>& vals) const;
+
+  std::vector<Node> nodes_;
+  std::vector<Index> args_;
+  std::vector<lexer::Symbol> varNames_;
+  std::vector<Index> varInits_;
+};
+
+}  // namespace parser
+}  // namespace kaso
@@ -1,6 +1,12 @@
 #include "parser/Function.h"
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/Casting.h>
+#include <algorithm>
+#include "global/FastMath.h"
 #include "global/Global.h"
+#include "memo/Memo.h"
+#include "parser/CodeGen.h"
 
 namespace kaso {
 namespace parser {
@@ -10,50 +16,144 @@ llvm::Function* Prototype::codeGen() {
   std::vector<llvm::Type*> doubles(args_.size(), type);
   auto ft = llvm::FunctionType::get(type, doubles, false);
   auto link = llvm::Function::ExternalLinkage;
-  auto f = llvm::Function::Create(ft, link, name_, global::gModule().get());
+  auto f = llvm::Function::Create(ft, link, lexer::symbolName(name_),
+                                  global::gModule().get());
 
   auto idx = 0;
   for (auto& arg : f->args()) {
-    arg.setName(args_[idx++]);
+    arg.setName(lexer::symbolName(args_[idx++]));
   }
 
   return f;
 }
 
-llvm::Function* Function::codeGen() {
+llvm::Function* Function::codeGen(OperatorTable& ops) {
   auto& p = *proto_;
-  global::storeProto(p.getName(), std::move(proto_));
+  global::storeProto(p.getName(), std::make_unique<Prototype>(p));
   auto func = global::getFunction(p.getName());
   if (!func) {
     return nullptr;
   }
+  if (func->hasAvailableExternallyLinkage()) {
+    // a call earlier in this module imported the version being replaced.
+    func->deleteBody();
+  }
 
+  auto savedOp = ops.get(p.getOperator());
   if (p.isBinaryOp()) {
-    global::setBinOpTokPrecedence(p.getOperator(), p.getBinOpPrecedence());
+    ops.defineBinary(p.getOperator(), p.getBinOpPrecedence(), p.getName());
+  } else if (p.isUnaryOp()) {
+    ops.defineUnary(p.getOperator(), p.getName());
   }
 
   auto bb = llvm::BasicBlock::Create(global::gContext(), "entry", func);
   global::gBuilder().SetInsertPoint(bb);
+  auto fastMath = fastMath_ | global::fastMath();
+  global::gBuilder().setFastMathFlags(global::toFastMathFlags(fastMath));
+  global::addFastMathAttributes(*func, fastMath);
 
+  // arguments can be assigned like any other variable.
   global::gNamedValues().clear();
+  auto idx = 0;
   for (auto& arg : func->args()) {
-    global::gNamedValues()[arg.getName()] = &arg;
+    auto name = p.getArgs()[idx++];
+    global::gNamedValues()[name] = emitLocal(name, &arg);
   }
 
   auto retVal = body_->codeGen();
+  global::gBuilder().clearFastMathFlags();
   if (retVal != nullptr) {
     global::gBuilder().CreateRet(retVal);
+    emitTailReturns(*func);
+    inlineImported(*func);
     llvm::verifyFunction(*func);
     global::gFPM()->run(*func);
+    requireTailCalls(*func);
+    if (memo_) {
+      auto& cache = memo::cacheFor(p.getName(), p.getArgs().size());
+      func = memo::wrap(*func, cache);
+    }
+    global::storeBody(*func);
     return func;
   }
 
   func->eraseFromParent();
-  if (p.isBinaryOp()) {
-    global::eraseBinOpTok(p.getOperator());
+  if (p.isUnaryOp() || p.isBinaryOp()) {
+    ops.restore(p.getOperator(), savedOp);
   }
   return nullptr;
 }
 
+std::vector<lexer::Symbol> Function::callees() const {
+  std::vector<lexer::Symbol> names;
+  auto add = [&](lexer::Symbol name) {
+    if (name != lexer::kNoSymbol &&
+        std::find(names.begin(), names.end(), name) == names.end()) {
+      names.push_back(name);
+    }
+  };
+
+  llvm::SmallVector<const Expr*, 16> work = {body_};
+  while (!work.empty()) {
+    auto e = work.pop_back_val();
+    if (e == nullptr) {
+      continue;
+    }
+    switch (e->kind()) {
+      case Expr::Kind::Number:
+      case Expr::Kind::Variable:
+        break;
+      case Expr::Kind::Binary: {
+        auto b = llvm::cast<BinaryExpr>(e);
+        add(b->getUserFn());
+        work.append({b->getLHS(), b->getRHS()});
+        break;
+      }
+      case Expr::Kind::Unary: {
+        auto u = llvm::cast<UnaryExpr>(e);
+        add(u->getUserFn());
+        work.push_back(u->getOperand());
+        break;
+      }
+      case Expr::Kind::Call: {
+        auto c = llvm::cast<CallExpr>(e);
+        add(c->getCallee());
+        for (uint32_t i = 0; i != c->getNumArgs(); ++i) {
+          work.push_back(c->getArg(i));
+        }
+        break;
+      }
+      case Expr::Kind::If: {
+        auto i = llvm::cast<IfExpr>(e);
+        work.append({i->getCond(), i->getThen(), i->getElse()});
+        break;
+      }
+      case Expr::Kind::For: {
+        auto f = llvm::cast<ForExpr>(e);
+        work.append({f->getStart(), f->getEnd(), f->getStep(), f->getBody()});
+        break;
+      }
+      case Expr::Kind::Var: {
+        auto v = llvm::cast<VarExpr>(e);
+        for (uint32_t i = 0; i != v->getNumVars(); ++i) {
+          work.push_back(v->getInit(i));
+        }
+        work.push_back(v->getBody());
+        break;
+      }
+      case Expr::Kind::Assign:
+        work.push_back(llvm::cast<AssignExpr>(e)->getValue());
+        break;
+    }
+  }
+  return names;
+}
+
+lexer::Symbol operatorFunctionName(lexer::Token op, bool binary) {
+  std::string name = binary ? "binary" : "unary";
+  name += lexer::spelling(op);
+  return lexer::intern(name);
+}
+
 }  // namespace parser
 }  // namespace kaso
\ No newline at end of file
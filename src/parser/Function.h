@@ -1,19 +1,24 @@
 #pragma once
 
 #include <llvm/IR/Function.h>
+#include <memory>
 #include <string>
 #include <vector>
+#include "lexer/TokenBuffer.h"
+#include "parser/Arena.h"
 #include "parser/Expr.h"
+#include "parser/OperatorTable.h"
+#include "parser/Simplify.h"
 
 namespace kaso {
 namespace parser {
 
 class Prototype {
  public:
-  Prototype(std::string name, std::vector<std::string> args,
+  Prototype(lexer::Symbol name, std::vector<lexer::Symbol> args,
             bool isOperator = false, lexer::Token op = lexer::Token::Error,
             uint32_t prec = 0)
-      : name_(std::move(name)),
+      : name_(name),
         args_(std::move(args)),
         isOperator_(isOperator),
         op_(op),
@@ -21,7 +26,9 @@ class Prototype {
 
   llvm::Function* codeGen();
 
-  const std::string getName() const { return name_; }
+  lexer::Symbol getName() const { return name_; }
+
+  const std::vector<lexer::Symbol>& getArgs() const { return args_; }
 
   bool isUnaryOp() const { return isOperator_ && args_.size() == 1; }
   bool isBinaryOp() const { return isOperator_ && args_.size() == 2; }
@@ -29,25 +36,80 @@ class Prototype {
   lexer::Token getOperator() const { return op_; }
   uint32_t getBinOpPrecedence() const { return precedence_; }
 
+  /// Declared with 'extern' rather than defined. Calls to an extern of the
+  /// C math library are emitted as the matching intrinsic, see
+  /// global::mathIntrinsic().
+  bool isExtern() const { return extern_; }
+  void setExtern(bool isExtern) { extern_ = isExtern; }
+
  private:
-  std::string name_;
-  std::vector<std::string> args_;
+  lexer::Symbol name_;
+  std::vector<lexer::Symbol> args_;
   bool isOperator_;
   lexer::Token op_;
   uint32_t precedence_;
+  bool extern_ = false;
+};
+
+/// Tokens [begin, end) of a buffer that a definition was parsed from, enough
+/// to parse it again once its AST is gone.
+struct Source {
+  std::shared_ptr<const lexer::TokenBuffer> tokens;
+  size_t begin = 0;
+  size_t end = 0;
 };
 
 class Function {
  public:
-  Function(std::unique_ptr<Prototype> proto, std::unique_ptr<Expr> body)
-      : proto_(std::move(proto)), body_(std::move(body)) {}
+  /// arena holds every node of body and is freed with the function. The body
+  /// is simplified right away, see simplify().
+  Function(std::unique_ptr<Prototype> proto, Expr* body,
+           std::unique_ptr<Arena> arena)
+      : proto_(std::move(proto)),
+        body_(simplify(body, *arena, proto_->getArgs())),
+        arena_(std::move(arena)) {}
 
-  llvm::Function* codeGen();
+  /// Emits the function into the current module. A user-defined operator is
+  /// registered in ops, so that later parses pick it up. A function can be
+  /// emitted again, e.g. into a new module after one of its callees changed.
+  llvm::Function* codeGen(OperatorTable& ops);
+
+  lexer::Symbol getName() const { return proto_->getName(); }
+
+  const Prototype& getProto() const { return *proto_; }
+
+  const Expr* getBody() const { return body_; }
+
+  /// Functions and operator functions called from the body, without
+  /// duplicates.
+  std::vector<lexer::Symbol> callees() const;
+
+  /// A memoized function is emitted behind a memo::Cache of its results,
+  /// which is only sound if it has no side effects.
+  bool isMemo() const { return memo_; }
+  void setMemo(bool memo) { memo_ = memo; }
+
+  /// global::FastMath flags the function is emitted with, on top of the
+  /// session's.
+  unsigned fastMath() const { return fastMath_; }
+  void setFastMath(unsigned flags) { fastMath_ = flags; }
+
+  /// Where a definition came from, see Parser::definition().
+  const Source& source() const { return source_; }
+  void setSource(Source source) { source_ = std::move(source); }
 
  private:
   std::unique_ptr<Prototype> proto_;
-  std::unique_ptr<Expr> body_;
+  Expr* body_;
+  std::unique_ptr<Arena> arena_;
+  bool memo_ = false;
+  unsigned fastMath_ = 0;
+  Source source_;
 };
 
+/// Interned name of the function implementing a user-defined operator, e.g.
+/// "binary|" or "unary!".
+lexer::Symbol operatorFunctionName(lexer::Token op, bool binary);
+
 }  // namespace parser
 }  // namespace kaso
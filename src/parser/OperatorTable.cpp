@@ -0,0 +1,60 @@
+#include "parser/OperatorTable.h"
+
+namespace kaso {
+namespace parser {
+
+OperatorTable::OperatorTable() {
+  for (size_t i = 0; i < ops_.size(); i++) {
+    auto tok = static_cast<lexer::Token>(i);
+    ops_[i] = {-1,
+               Assoc::Left,
+               Lowering::None,
+               Lowering::None,
+               lexer::isValidBinaryOperator(tok),
+               lexer::isValidUnaryOperator(tok),
+               lexer::kNoSymbol,
+               lexer::kNoSymbol};
+  }
+
+  // '=' is assignment, right associative and not definable.
+  at(lexer::Token::OpAssign) = {2,
+                                Assoc::Right,
+                                Lowering::Builtin,
+                                Lowering::None,
+                                false,
+                                false,
+                                lexer::kNoSymbol,
+                                lexer::kNoSymbol};
+
+  const std::pair<lexer::Token, int> builtins[] = {
+      {lexer::Token::OpLogicOr, 4}, {lexer::Token::OpLogicAnd, 6},
+      {lexer::Token::OpEQ, 8},      {lexer::Token::OpNE, 8},
+      {lexer::Token::OpLess, 10},   {lexer::Token::OpGreat, 10},
+      {lexer::Token::OpLE, 10},     {lexer::Token::OpGE, 10},
+      {lexer::Token::OpAdd, 20},    {lexer::Token::OpSub, 20},
+      {lexer::Token::OpMul, 40},    {lexer::Token::OpDiv, 40}};
+  for (const auto& b : builtins) {
+    at(b.first).precedence = b.second;
+    at(b.first).binary = Lowering::Builtin;
+  }
+}
+
+void OperatorTable::defineBinary(lexer::Token tok, int prec, lexer::Symbol fn) {
+  auto& op = at(tok);
+  op.precedence = prec;
+  op.binary = Lowering::User;
+  op.binaryFn = fn;
+}
+
+void OperatorTable::defineUnary(lexer::Token tok, lexer::Symbol fn) {
+  auto& op = at(tok);
+  op.unary = Lowering::User;
+  op.unaryFn = fn;
+}
+
+void OperatorTable::restore(lexer::Token tok, const OperatorInfo& info) {
+  at(tok) = info;
+}
+
+}  // namespace parser
+}  // namespace kaso
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include "lexer/Lexer.h"
+
+namespace kaso {
+namespace parser {
+
+/// How an operator is emitted.
+enum class Lowering : uint8_t {
+  None,     // not defined in this form
+  Builtin,  // native instructions
+  User,     // a call to a user-defined 'binary'/'unary' function
+};
+
+enum class Assoc : uint8_t { Left, Right };
+
+struct OperatorInfo {
+  int precedence;  // binary precedence, -1 if the token is no binary operator
+  Assoc assoc;
+  Lowering binary;
+  Lowering unary;
+  // whether 'def binary'/'def unary' may define the token.
+  bool definableBinary;
+  bool definableUnary;
+  lexer::Symbol binaryFn;  // implementing functions for Lowering::User
+  lexer::Symbol unaryFn;
+};
+
+/// Flat table of operator properties indexed by token kind. Each parser owns
+/// one, seeded with the builtin operators, and user-defined operators are
+/// registered into it when their definition is compiled, so lookups are a
+/// single array index and no state is shared between sessions.
+class OperatorTable {
+ public:
+  OperatorTable();
+
+  const OperatorInfo& get(lexer::Token tok) const {
+    return ops_[static_cast<size_t>(tok)];
+  }
+
+  int precedence(lexer::Token tok) const { return get(tok).precedence; }
+
+  void defineBinary(lexer::Token tok, int prec, lexer::Symbol fn);
+  void defineUnary(lexer::Token tok, lexer::Symbol fn);
+
+  /// Puts back an entry saved with get(), e.g. when a definition fails.
+  void restore(lexer::Token tok, const OperatorInfo& info);
+
+ private:
+  OperatorInfo& at(lexer::Token tok) { return ops_[static_cast<size_t>(tok)]; }
+
+ private:
+  std::array<OperatorInfo, lexer::kNumTokens> ops_;
+};
+
+}  // namespace parser
+}  // namespace kaso
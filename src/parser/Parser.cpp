@@ -1,18 +1,34 @@
 #include "parser/Parser.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Casting.h>
+#include <algorithm>
+#include "global/FastMath.h"
 
 namespace kaso {
 namespace parser {
 
 Parser::Parser(lexer::Lexer lex)
-    : lexer_(std::move(lex)), curTok_(lexer::Token::Error) {}
-
-std::unique_ptr<Expr> Parser::numberExpr() {
-  auto result = std::make_unique<NumberExpr>(lexer_.numVal());
+    : lexer_(std::make_unique<lexer::Lexer>(std::move(lex))),
+      tokPos_(0),
+      tokNext_(0),
+      tokEnd_(0),
+      curTok_(lexer::Token::Error) {}
+
+Parser::Parser(std::shared_ptr<const lexer::TokenBuffer> tokens, size_t begin,
+               size_t end)
+    : tokens_(std::move(tokens)),
+      tokPos_(begin),
+      tokNext_(begin),
+      tokEnd_(std::min(end, tokens_->size())),
+      curTok_(lexer::Token::Error) {}
+
+Expr* Parser::numberExpr() {
+  auto result = arena().make<NumberExpr>(curNumVal());
   getNextToken();
-  return std::move(result);
+  return result;
 }
 
-std::unique_ptr<Expr> Parser::parenExpr() {
+Expr* Parser::parenExpr() {
   getNextToken();
   auto v = expression();
   if (!v) {
@@ -25,21 +41,21 @@ std::unique_ptr<Expr> Parser::parenExpr() {
   return v;
 }
 
-std::unique_ptr<Expr> Parser::identifierExpr() {
-  std::string idName = lexer_.strVal();
+Expr* Parser::identifierExpr() {
+  auto idName = curSymVal();
 
   getNextToken();  // eat identifier
   if (curTok_ != lexer::Token::LeftParen) {
-    return std::make_unique<VariableExpr>(idName);
+    return arena().make<VariableExpr>(idName);
   }
 
   getNextToken();  // eat '('
-  std::vector<std::unique_ptr<Expr>> args;
+  llvm::SmallVector<Expr*, 8> args;
   if (curTok_ != lexer::Token::RightParen) {
     while (true) {
       auto arg = expression();
       if (arg != nullptr) {
-        args.push_back(std::move(arg));
+        args.push_back(arg);
       } else {
         return nullptr;
       }
@@ -57,10 +73,12 @@ std::unique_ptr<Expr> Parser::identifierExpr() {
   }
 
   getNextToken();  // eat ')'
-  return std::make_unique<CallExpr>(idName, std::move(args));
+  auto argv = arena().copy(args.data(), args.size());
+  return arena().make<CallExpr>(idName, argv,
+                                static_cast<uint32_t>(args.size()));
 }
 
-std::unique_ptr<Expr> Parser::primary() {
+Expr* Parser::primary() {
   switch (curTok_) {
     case lexer::Token::Identifier:
       return identifierExpr();
@@ -72,31 +90,34 @@ std::unique_ptr<Expr> Parser::primary() {
       return ifExpr();
     case lexer::Token::For:
       return forExpr();
+    case lexer::Token::Var:
+      return varExpr();
     default:
       return logError("unknown token when expecting an expression");
   }
 }
 
-std::unique_ptr<Expr> Parser::expression() {
+Expr* Parser::expression() {
   auto lhs = unary();
   if (!lhs) {
     return nullptr;
   }
 
-  return binOpRHS(0, std::move(lhs));
+  return binOpRHS(0, lhs);
 }
 
 // the minimal operator precedence that the function is allowed to eat.
-std::unique_ptr<Expr> Parser::binOpRHS(int prec, std::unique_ptr<Expr> lhs) {
+Expr* Parser::binOpRHS(int prec, Expr* lhs) {
   while (true) {
-    auto tokPrec = global::getBinOpTokPrecedence(curTok_);
-    if (tokPrec < prec) {
+    const auto& op = ops_.get(curTok_);
+    if (op.precedence < prec) {
       return lhs;
     }
 
     // ok, we know this is a bin op.
     auto binOp = curTok_;
-    auto binOpStr = lexer_.strVal();
+    auto tokPrec = op.precedence;
+    auto userFn = op.binary == Lowering::User ? op.binaryFn : lexer::kNoSymbol;
     getNextToken();
 
     // parse the unary expression after the binary operator
@@ -105,40 +126,50 @@ std::unique_ptr<Expr> Parser::binOpRHS(int prec, std::unique_ptr<Expr> lhs) {
       return nullptr;
     }
 
-    auto nextTokPrec = global::getBinOpTokPrecedence(curTok_);
-    if (nextTokPrec > tokPrec) {
-      rhs = binOpRHS(tokPrec + 1, std::move(rhs));
+    // let a tighter operator, or the same one if it is right associative,
+    // take rhs as its left operand first.
+    const auto& next = ops_.get(curTok_);
+    if (next.precedence > tokPrec ||
+        (next.precedence == tokPrec && next.assoc == Assoc::Right)) {
+      auto minPrec = next.assoc == Assoc::Right ? tokPrec : tokPrec + 1;
+      rhs = binOpRHS(minPrec, rhs);
       if (!rhs) {
         return nullptr;
       }
     }
 
-    lhs = std::make_unique<BinaryExpr>(binOp, binOpStr, std::move(lhs),
-                                       std::move(rhs));
+    if (binOp == lexer::Token::OpAssign) {
+      auto var = llvm::dyn_cast<VariableExpr>(lhs);
+      if (var == nullptr) {
+        return logError("destination of '=' must be a variable");
+      }
+      lhs = arena().make<AssignExpr>(var->getName(), rhs);
+      continue;
+    }
+    lhs = arena().make<BinaryExpr>(binOp, lhs, rhs, userFn);
   }
 }
 
 std::unique_ptr<Prototype> Parser::prototype() {
-  std::string fnName;
+  lexer::Symbol fnName;
   uint32_t kind = 0;  // 0 = identifier, 1 = unary, 2 = binary.
   uint32_t binaryPrecedence = 30;
 
   auto op = lexer::Token::Error;
   switch (curTok_) {
     case lexer::Token::Identifier:
-      fnName = lexer_.strVal();
+      fnName = curSymVal();
       kind = 0;
       getNextToken();
       break;
 
     case lexer::Token::Unary:
       getNextToken();
-      if (!lexer::isValidUnaryOperator(curTok_)) {
+      if (!ops_.get(curTok_).definableUnary) {
         return logErrorP("Invalid unary operator");
       }
 
-      fnName = "unary";
-      fnName += lexer_.strVal();
+      fnName = operatorFunctionName(curTok_, false);
       kind = 1;
       op = curTok_;
 
@@ -147,21 +178,20 @@ std::unique_ptr<Prototype> Parser::prototype() {
 
     case lexer::Token::Binary: {
       getNextToken();
-      if (!lexer::isValidBinaryOperator(curTok_)) {
+      if (!ops_.get(curTok_).definableBinary) {
         return logErrorP("Invalid binary operator");
       }
 
-      fnName = "binary";
-      fnName += lexer_.strVal();
+      fnName = operatorFunctionName(curTok_, true);
       kind = 2;
       op = curTok_;
 
       getNextToken();
       if (curTok_ == lexer::Token::Number) {
-        if (lexer_.numVal() < 1 || lexer_.numVal() > 100) {
+        if (curNumVal() < 1 || curNumVal() > 100) {
           return logErrorP("Invalid precedence: must be 1..100");
         }
-        binaryPrecedence = (uint32_t)lexer_.numVal();
+        binaryPrecedence = (uint32_t)curNumVal();
         getNextToken();
       }
       break;
@@ -174,9 +204,9 @@ std::unique_ptr<Prototype> Parser::prototype() {
     return logErrorP("Expected '(' in prototype");
   }
 
-  std::vector<std::string> argNames;
+  std::vector<lexer::Symbol> argNames;
   while (getNextToken() == lexer::Token::Identifier) {
-    argNames.push_back(lexer_.strVal());
+    argNames.push_back(curSymVal());
   }
   if (curTok_ != lexer::Token::RightParen) {
     return logErrorP("Expected ')' in prototype");
@@ -193,32 +223,113 @@ std::unique_ptr<Prototype> Parser::prototype() {
 }
 
 std::unique_ptr<Function> Parser::definition() {
-  getNextToken();
-  auto proto = prototype();
+  auto begin = tokPos_;
+  spelling_ = tokens_ == nullptr;
+  spelled_.clear();
+  auto fn = annotatedDefinition();
+  spelling_ = false;
+  if (fn == nullptr) {
+    return nullptr;
+  }
+  if (tokens_ != nullptr) {
+    fn->setSource({tokens_, begin, tokPos_});
+  } else {
+    auto tokens = std::make_shared<const lexer::TokenBuffer>(
+        llvm::MemoryBuffer::getMemBufferCopy(spelled_));
+    fn->setSource({tokens, 0, tokens->size() - 1});
+  }
+  return fn;
+}
+
+std::unique_ptr<Function> Parser::annotatedDefinition() {
+  static const auto memoName = lexer::intern("memo");
+  static const auto fastName = lexer::intern("fast");
+  getNextToken();  // eat def.
+  auto memo = false;
+  unsigned fastMath = 0;
+  // 'memo' and 'fast' are plain names anywhere else, and here too when what
+  // follows is the parameter list of a function they name.
+  std::unique_ptr<Prototype> proto;
+  while (proto == nullptr && curTok_ == lexer::Token::Identifier) {
+    auto name = curSymVal();
+    if (name != memoName && name != fastName) {
+      break;
+    }
+    getNextToken();  // eat memo or fast.
+    if (curTok_ != lexer::Token::LeftParen) {
+      if (name == memoName) {
+        memo = true;
+      } else {
+        fastMath |= global::kFastAll;
+      }
+      continue;
+    }
+    std::vector<lexer::Symbol> names;
+    while (getNextToken() == lexer::Token::Identifier) {
+      names.push_back(curSymVal());
+    }
+    if (curTok_ != lexer::Token::RightParen) {
+      logError("Expected ')' in prototype");
+      return nullptr;
+    }
+    getNextToken();  // eat ')'
+
+    // fast-math flags, or the parameters if none of them is a flag.
+    unsigned flags = 0;
+    size_t known = 0;
+    for (auto n : names) {
+      auto flag = name == fastName ? global::fastMathFlag(lexer::symbolName(n))
+                                   : 0;
+      flags |= flag;
+      known += flag != 0;
+    }
+    if (known != 0 && known != names.size()) {
+      logError("Unknown fast-math flag");
+      return nullptr;
+    }
+    if (known != 0) {
+      fastMath |= flags;
+    } else {
+      proto = std::make_unique<Prototype>(name, std::move(names));
+    }
+  }
+  if (proto == nullptr) {
+    proto = prototype();
+  }
   if (!proto) {
     return nullptr;
   }
+  arena_ = std::make_unique<Arena>();
   if (auto e = expression()) {
-    return std::make_unique<Function>(std::move(proto), std::move(e));
+    auto fn =
+        std::make_unique<Function>(std::move(proto), e, std::move(arena_));
+    fn->setMemo(memo);
+    fn->setFastMath(fastMath);
+    return fn;
   }
   return nullptr;
 }
 
 std::unique_ptr<Function> Parser::topLevelExpr() {
+  arena_ = std::make_unique<Arena>();
   if (auto e = expression()) {
-    auto proto = std::make_unique<Prototype>("__anonymous_expr",
-                                             std::vector<std::string>());
-    return std::make_unique<Function>(std::move(proto), std::move(e));
+    auto proto = std::make_unique<Prototype>(
+        lexer::intern("__anonymous_expr"), std::vector<lexer::Symbol>());
+    return std::make_unique<Function>(std::move(proto), e, std::move(arena_));
   }
   return nullptr;
 }
 
 std::unique_ptr<Prototype> Parser::externDef() {
   getNextToken();
-  return prototype();
+  auto proto = prototype();
+  if (proto != nullptr) {
+    proto->setExtern(true);
+  }
+  return proto;
 }
 
-std::unique_ptr<Expr> Parser::ifExpr() {
+Expr* Parser::ifExpr() {
   getNextToken();
   auto cond = expression();
   if (cond == nullptr) {
@@ -245,18 +356,17 @@ std::unique_ptr<Expr> Parser::ifExpr() {
     return nullptr;
   }
 
-  return std::make_unique<IfExpr>(std::move(cond), std::move(then),
-                                  std::move(els));
+  return arena().make<IfExpr>(cond, then, els);
 }
 
-std::unique_ptr<Expr> Parser::forExpr() {
+Expr* Parser::forExpr() {
   getNextToken();
 
   if (curTok_ != lexer::Token::Identifier) {
     return logError("expected identifier after for");
   }
 
-  std::string idName = lexer_.strVal();
+  auto idName = curSymVal();
   getNextToken();
 
   if (curTok_ != lexer::Token::OpAssign) {
@@ -278,7 +388,7 @@ std::unique_ptr<Expr> Parser::forExpr() {
     return nullptr;
   }
 
-  std::unique_ptr<Expr> step;
+  Expr* step = nullptr;
   if (curTok_ == lexer::Token::Comma) {
     getNextToken();
     step = expression();
@@ -297,31 +407,122 @@ std::unique_ptr<Expr> Parser::forExpr() {
     return nullptr;
   }
 
-  return std::make_unique<ForExpr>(idName, std::move(start), std::move(end),
-                                   std::move(step), std::move(body));
+  return arena().make<ForExpr>(idName, start, end, step, body);
 }
 
-std::unique_ptr<Expr> Parser::unary() {
-  if (!lexer::isValidUnaryOperator(curTok_)) {
+Expr* Parser::varExpr() {
+  getNextToken();  // eat 'var'
+
+  llvm::SmallVector<lexer::Symbol, 4> names;
+  llvm::SmallVector<Expr*, 4> inits;
+  if (curTok_ != lexer::Token::Identifier) {
+    return logError("expected identifier after var");
+  }
+  while (true) {
+    names.push_back(curSymVal());
+    getNextToken();  // eat identifier
+
+    Expr* init = nullptr;
+    if (curTok_ == lexer::Token::OpAssign) {
+      getNextToken();  // eat '='
+      init = expression();
+      if (init == nullptr) {
+        return nullptr;
+      }
+    }
+    inits.push_back(init);
+
+    if (curTok_ != lexer::Token::Comma) {
+      break;
+    }
+    getNextToken();  // eat ','
+    if (curTok_ != lexer::Token::Identifier) {
+      return logError("expected identifier list after var");
+    }
+  }
+
+  if (curTok_ != lexer::Token::In) {
+    return logError("expected 'in' keyword after 'var'");
+  }
+  getNextToken();  // eat 'in'
+
+  auto body = expression();
+  if (body == nullptr) {
+    return nullptr;
+  }
+
+  auto n = static_cast<uint32_t>(names.size());
+  return arena().make<VarExpr>(arena().copy(names.data(), n),
+                               arena().copy(inits.data(), n), n, body);
+}
+
+Expr* Parser::unary() {
+  const auto& info = ops_.get(curTok_);
+  if (!info.definableUnary) {
     return primary();
   }
 
   auto op = curTok_;
-  auto opStr = lexer_.strVal();
+  auto userFn = info.unary == Lowering::User ? info.unaryFn : lexer::kNoSymbol;
   getNextToken();
   if (auto operand = unary()) {
-    return std::make_unique<UnaryExpr>(op, opStr, std::move(operand));
+    return arena().make<UnaryExpr>(op, operand, userFn);
   }
 
   return nullptr;
 }
 
 lexer::Token Parser::getNextToken() {
-  curTok_ = lexer_.getTok();
+  if (!tokens_) {
+    if (spelling_) {
+      auto text = lexer::spelling(curTok_);
+      spelled_ += *text != '\0' ? text : lexer_->strRef().str();
+      spelled_ += ' ';
+    }
+    curTok_ = lexer_->getTok();
+    return curTok_;
+  }
+
+  tokPos_ = tokNext_;
+  if (tokNext_ < tokEnd_) {
+    tokNext_++;
+  }
+  curTok_ = tokPos_ < tokEnd_ ? tokens_->kind(tokPos_) : lexer::Token::Eof;
   return curTok_;
 }
 
 lexer::Token Parser::curToken() { return curTok_; }
 
+OperatorTable& Parser::operators() { return ops_; }
+
+Arena& Parser::arena() {
+  if (arena_ == nullptr) {
+    arena_ = std::make_unique<Arena>();
+  }
+  return *arena_;
+}
+
+lexer::Token Parser::peekToken(size_t n) {
+  if (!tokens_) {
+    return lexer::Token::Error;
+  }
+  auto i = tokPos_ + n;
+  return i < tokEnd_ ? tokens_->kind(i) : lexer::Token::Eof;
+}
+
+size_t Parser::tokenIndex() { return tokPos_; }
+
+llvm::StringRef Parser::curText() {
+  return tokens_ ? tokens_->text(tokPos_) : lexer_->strRef();
+}
+
+double Parser::curNumVal() {
+  return tokens_ ? tokens_->numVal(tokPos_) : lexer_->numVal();
+}
+
+lexer::Symbol Parser::curSymVal() {
+  return tokens_ ? tokens_->symVal(tokPos_) : lexer_->symVal();
+}
+
 }  // namespace parser
 }  // namespace kaso
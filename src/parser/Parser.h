@@ -4,8 +4,10 @@
 #include <map>
 #include "global/Global.h"
 #include "lexer/Lexer.h"
+#include "lexer/TokenBuffer.h"
 #include "parser/Expr.h"
 #include "parser/Function.h"
+#include "parser/OperatorTable.h"
 
 namespace kaso {
 namespace parser {
@@ -14,38 +16,50 @@ class Parser {
  public:
   explicit Parser(lexer::Lexer lex);
 
+  /// Parses tokens [begin, end) of a pre-tokenized buffer. Tokens at or past
+  /// end read as Eof, so several parsers can work on slices of one buffer.
+  explicit Parser(std::shared_ptr<const lexer::TokenBuffer> tokens,
+                  size_t begin = 0, size_t end = SIZE_MAX);
+
   /// numberexpr ::= number
-  std::unique_ptr<Expr> numberExpr();
+  Expr* numberExpr();
 
   /// parenexpr ::= '(' expression ')'
-  std::unique_ptr<Expr> parenExpr();
+  Expr* parenExpr();
 
   /// identifierexpr
   ///   ::= identifier
   ///   ::= identifier '(' expression* ')'
-  std::unique_ptr<Expr> identifierExpr();
+  Expr* identifierExpr();
 
   /// primary
   ///   ::= identifierexpr
   ///   ::= numberexpr
   ///   ::= parenexpr
-  std::unique_ptr<Expr> primary();
+  Expr* primary();
 
   /// expression
   ///   ::= primary binoprhs
   ///
-  std::unique_ptr<Expr> expression();
+  Expr* expression();
 
   /// binoprhs
   ///   ::= ('+' primary)*
-  std::unique_ptr<Expr> binOpRHS(int prec, std::unique_ptr<Expr> lhs);
+  Expr* binOpRHS(int prec, Expr* lhs);
 
   /// prototype
   ///   ::= id '(' id* ')'
   ///   ::= binary LETTER number? (id, id)
   std::unique_ptr<Prototype> prototype();
 
-  /// definition ::= 'def' prototype expression
+  /// definition ::= 'def' annotation* prototype expression
+  /// annotation ::= 'memo' | 'fast' ('(' flag+ ')')?
+  ///
+  /// 'memo' and 'fast' are identifiers, and name the function instead when a
+  /// parameter list follows: "memo(" or "fast(" with no fast-math flag in it.
+  ///
+  /// The function records its Source: its range of the token buffer, or on
+  /// a stream a buffer of its own holding the tokens read for it.
   std::unique_ptr<Function> definition();
 
   /// toplevelexpr ::= expression
@@ -55,23 +69,57 @@ class Parser {
   std::unique_ptr<Prototype> externDef();
 
   /// ifexpr ::= 'if' expression 'then' expression 'else' expression
-  std::unique_ptr<Expr> ifExpr();
+  Expr* ifExpr();
 
   /// forexpr ::= 'for' identifier '=' expr ',' expr (',' expr)? 'in' expression
-  std::unique_ptr<Expr> forExpr();
+  Expr* forExpr();
+
+  /// varexpr ::= 'var' identifier ('=' expression)?
+  ///                   (',' identifier ('=' expression)?)* 'in' expression
+  Expr* varExpr();
 
   /// unary
   ///   ::= primary
   ///   ::= '!' unary
-  std::unique_ptr<Expr> unary();
+  Expr* unary();
 
   lexer::Token getNextToken();
 
   lexer::Token curToken();
 
+  OperatorTable& operators();
+
+  /// Kind of the token n positions after the current one. Lookahead is only
+  /// available on token buffers; a streaming parser returns Token::Error.
+  lexer::Token peekToken(size_t n = 1);
+
+  /// Index of the current token in the token buffer.
+  size_t tokenIndex();
+
+  /// Source text of the current token, e.g. a whole command line. A streaming
+  /// parser only keeps it until the next token.
+  llvm::StringRef curText();
+
+ private:
+  double curNumVal();
+  lexer::Symbol curSymVal();
+
+  /// Arena of the item being parsed; definition() and topLevelExpr() hand it
+  /// over to the Function they build.
+  Arena& arena();
+
+  std::unique_ptr<Function> annotatedDefinition();
+
  private:
-  lexer::Lexer lexer_;
+  std::unique_ptr<lexer::Lexer> lexer_;
+  std::shared_ptr<const lexer::TokenBuffer> tokens_;
+  size_t tokPos_, tokNext_, tokEnd_;
   lexer::Token curTok_;
+  OperatorTable ops_;
+  std::unique_ptr<Arena> arena_;
+  /// the tokens a stream has consumed since spelling_ was set, spelled out.
+  bool spelling_ = false;
+  std::string spelled_;
 };
 
 }  // namespace parser
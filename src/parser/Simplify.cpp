@@ -0,0 +1,234 @@
+#include "parser/Simplify.h"
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/Support/Casting.h>
+#include <algorithm>
+#include <cmath>
+#include "parser/Builtin.h"
+
+namespace kaso {
+namespace parser {
+
+namespace {
+
+bool asNumber(const Expr* e, double& val) {
+  if (auto n = llvm::dyn_cast<NumberExpr>(e)) {
+    val = n->getVal();
+    return true;
+  }
+  return false;
+}
+
+bool isNumber(const Expr* e, double val) {
+  double v;
+  return asNumber(e, v) && v == val && std::signbit(v) == std::signbit(val);
+}
+
+using Scope = llvm::SmallVector<lexer::Symbol, 8>;
+
+Expr* simplify(Expr* e, Arena& arena, Scope& scope);
+
+/// True if e has no calls or assignments and every variable it reads is in
+/// scope, so dropping it loses neither an effect nor an "Unknown variable" or
+/// "Unknown function" error.
+bool isDroppable(const Expr* e, Scope& scope) {
+  if (e == nullptr) {
+    return true;
+  }
+  switch (e->kind()) {
+    case Expr::Kind::Number:
+      return true;
+    case Expr::Kind::Variable: {
+      auto name = llvm::cast<VariableExpr>(e)->getName();
+      return std::find(scope.begin(), scope.end(), name) != scope.end();
+    }
+    case Expr::Kind::Binary: {
+      auto b = llvm::cast<BinaryExpr>(e);
+      return b->getUserFn() == lexer::kNoSymbol &&
+             isDroppable(b->getLHS(), scope) && isDroppable(b->getRHS(), scope);
+    }
+    case Expr::Kind::If: {
+      auto i = llvm::cast<IfExpr>(e);
+      return isDroppable(i->getCond(), scope) &&
+             isDroppable(i->getThen(), scope) &&
+             isDroppable(i->getElse(), scope);
+    }
+    case Expr::Kind::For: {
+      auto f = llvm::cast<ForExpr>(e);
+      if (!isDroppable(f->getStart(), scope)) {
+        return false;
+      }
+      scope.push_back(f->getVarName());
+      auto droppable = isDroppable(f->getEnd(), scope) &&
+                       isDroppable(f->getStep(), scope) &&
+                       isDroppable(f->getBody(), scope);
+      scope.pop_back();
+      return droppable;
+    }
+    default:
+      return false;
+  }
+}
+
+Expr* simplifyBinary(BinaryExpr* b, Arena& arena, Scope& scope) {
+  auto lhs = simplify(b->getLHS(), arena, scope);
+  auto rhs = simplify(b->getRHS(), arena, scope);
+  if (b->getUserFn() == lexer::kNoSymbol) {
+    double l, r;
+    if (asNumber(lhs, l) && asNumber(rhs, r)) {
+      if (auto val = evalBinary(b->getOp(), l, r)) {
+        return arena.make<NumberExpr>(*val);
+      }
+    }
+    // the right operand is never evaluated.
+    if (asNumber(lhs, l) && isLogic(b->getOp()) &&
+        isTrue(l) == (b->getOp() == lexer::Token::OpLogicOr) &&
+        isDroppable(rhs, scope)) {
+      return arena.make<NumberExpr>(isTrue(l) ? 1.0 : 0.0);
+    }
+
+    switch (b->getOp()) {
+      case lexer::Token::OpMul:
+        if (isNumber(rhs, 1.0)) {
+          return lhs;
+        }
+        if (isNumber(lhs, 1.0)) {
+          return rhs;
+        }
+        break;
+      case lexer::Token::OpSub:
+        if (isNumber(rhs, 0.0)) {
+          return lhs;
+        }
+        break;
+      case lexer::Token::OpAdd:
+        if (isNumber(rhs, -0.0)) {
+          return lhs;
+        }
+        if (isNumber(lhs, -0.0)) {
+          return rhs;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  if (lhs == b->getLHS() && rhs == b->getRHS()) {
+    return b;
+  }
+  return arena.make<BinaryExpr>(b->getOp(), lhs, rhs, b->getUserFn());
+}
+
+Expr* simplify(Expr* e, Arena& arena, Scope& scope) {
+  switch (e->kind()) {
+    case Expr::Kind::Number:
+    case Expr::Kind::Variable:
+      return e;
+    case Expr::Kind::Binary:
+      return simplifyBinary(llvm::cast<BinaryExpr>(e), arena, scope);
+    case Expr::Kind::Unary: {
+      auto u = llvm::cast<UnaryExpr>(e);
+      auto operand = simplify(u->getOperand(), arena, scope);
+      if (operand == u->getOperand()) {
+        return u;
+      }
+      return arena.make<UnaryExpr>(u->getOp(), operand, u->getUserFn());
+    }
+    case Expr::Kind::Call: {
+      auto c = llvm::cast<CallExpr>(e);
+      llvm::SmallVector<Expr*, 8> args;
+      auto changed = false;
+      for (uint32_t i = 0; i != c->getNumArgs(); ++i) {
+        args.push_back(simplify(c->getArg(i), arena, scope));
+        changed |= args.back() != c->getArg(i);
+      }
+      if (!changed) {
+        return c;
+      }
+      return arena.make<CallExpr>(c->getCallee(),
+                                  arena.copy(args.data(), args.size()),
+                                  c->getNumArgs());
+    }
+    case Expr::Kind::If: {
+      auto i = llvm::cast<IfExpr>(e);
+      auto cond = simplify(i->getCond(), arena, scope);
+      auto then = simplify(i->getThen(), arena, scope);
+      auto els = simplify(i->getElse(), arena, scope);
+      double c;
+      if (asNumber(cond, c) && isDroppable(isTrue(c) ? els : then, scope)) {
+        return isTrue(c) ? then : els;
+      }
+      if (cond == i->getCond() && then == i->getThen() &&
+          els == i->getElse()) {
+        return i;
+      }
+      return arena.make<IfExpr>(cond, then, els);
+    }
+    case Expr::Kind::For: {
+      auto f = llvm::cast<ForExpr>(e);
+      auto start = simplify(f->getStart(), arena, scope);
+      scope.push_back(f->getVarName());
+      auto end = simplify(f->getEnd(), arena, scope);
+      auto step =
+          f->getStep() ? simplify(f->getStep(), arena, scope) : nullptr;
+      auto body = simplify(f->getBody(), arena, scope);
+      // a false end runs the body once; without calls nothing is left of it
+      // but the loop's value.
+      double c;
+      auto once = asNumber(end, c) && !isTrue(c) &&
+                  isDroppable(step, scope) && isDroppable(body, scope);
+      scope.pop_back();
+      if (once && isDroppable(start, scope)) {
+        return arena.make<NumberExpr>(0.0);
+      }
+      if (start == f->getStart() && end == f->getEnd() &&
+          step == f->getStep() && body == f->getBody()) {
+        return f;
+      }
+      return arena.make<ForExpr>(f->getVarName(), start, end, step, body);
+    }
+    case Expr::Kind::Var: {
+      auto v = llvm::cast<VarExpr>(e);
+      llvm::SmallVector<Expr*, 4> inits;
+      auto changed = false;
+      for (uint32_t i = 0; i != v->getNumVars(); ++i) {
+        auto init = v->getInit(i);
+        inits.push_back(init != nullptr ? simplify(init, arena, scope)
+                                        : nullptr);
+        changed |= inits.back() != init;
+        scope.push_back(v->getVarName(i));
+      }
+      auto body = simplify(v->getBody(), arena, scope);
+      scope.resize(scope.size() - v->getNumVars());
+      if (!changed && body == v->getBody()) {
+        return v;
+      }
+      llvm::SmallVector<lexer::Symbol, 4> names;
+      for (uint32_t i = 0; i != v->getNumVars(); ++i) {
+        names.push_back(v->getVarName(i));
+      }
+      return arena.make<VarExpr>(arena.copy(names.data(), names.size()),
+                                 arena.copy(inits.data(), inits.size()),
+                                 v->getNumVars(), body);
+    }
+    case Expr::Kind::Assign: {
+      auto a = llvm::cast<AssignExpr>(e);
+      auto value = simplify(a->getValue(), arena, scope);
+      if (value == a->getValue()) {
+        return a;
+      }
+      return arena.make<AssignExpr>(a->getVarName(), value);
+    }
+  }
+  return e;
+}
+
+}  // namespace
+
+Expr* simplify(Expr* e, Arena& arena, llvm::ArrayRef<lexer::Symbol> params) {
+  Scope scope(params.begin(), params.end());
+  return simplify(e, arena, scope);
+}
+
+}  // namespace parser
+}  // namespace kaso
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <llvm/ADT/ArrayRef.h>
+#include "parser/Arena.h"
+#include "parser/Expr.h"
+
+namespace kaso {
+namespace parser {
+
+/// Folds constant subtrees of builtin operators and '&&'/'||' whose left
+/// operand decides them, keeps only the taken branch of an if on a literal
+/// condition, drops a for loop that runs once and has no calls, and removes
+/// the identities x*1, 1*x, x-0 and x+(-0). Every rewrite gives the same
+/// result as the IR it replaces, NaNs and signed zeros included. Returns
+/// the new root; new nodes are allocated in arena and the old ones are left
+/// in place. A subtree is only dropped if it reads no variable outside params
+/// and its own bindings, and calls nothing, so codegen still reports unknown
+/// names in it.
+Expr* simplify(Expr* e, Arena& arena,
+               llvm::ArrayRef<lexer::Symbol> params = {});
+
+}  // namespace parser
+}  // namespace kaso
@@ -1,12 +1,75 @@
 #include <gflags/gflags.h>
+#include "global/FastMath.h"
+#include "global/MathLib.h"
+#include "global/Target.h"
 #include "shell/shell.h"
 
 DEFINE_bool(verbose, true, "dump LLVM IR");
+DEFINE_string(input, "", "source file to run instead of reading stdin");
+DEFINE_bool(interpret, true, "run top-level expressions without the JIT");
+DEFINE_int32(jobs, 1, "threads parsing --input, 0 for one per core");
+DEFINE_int32(module_items, 64,
+             "definitions and expressions of --input compiled into one "
+             "module before its expressions run; commands, %flush and "
+             "redefinitions end a module early");
+DEFINE_int32(tier_threshold, 1000,
+             "calls before a definition is recompiled at O3 in the "
+             "background, 0 to optimize every definition right away");
+DEFINE_int32(opt, 3, "optimization level of optimized code, 0 to 3");
+DEFINE_string(passes, "",
+              "comma-separated LLVM passes to run instead of an -O level, "
+              "e.g. licm,loop-unroll,gvn");
+DEFINE_string(veclib, "",
+              "vector math library loops may call for math externs, "
+              "Accelerate or SVML, which has to be linked in or preloaded");
+DEFINE_string(mcpu, "",
+              "CPU to compile for instead of the host's, e.g. x86-64 or "
+              "skylake-avx512");
+DEFINE_string(mattr, "",
+              "comma-separated features to turn on or off on top of the "
+              "CPU's, e.g. +avx2,-fma");
+DEFINE_string(fast_math, "",
+              "fast-math flags for every definition, e.g. fast or "
+              "contract,nnan; strict IEEE semantics when empty");
 
 int main(int argc, char* argv[]) {
   gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_opt < 0 || FLAGS_opt > 3) {
+    fprintf(stderr, "Error: --opt must be between 0 and 3\n");
+    return 1;
+  }
+  if (FLAGS_module_items < 1) {
+    fprintf(stderr, "Error: --module_items must be at least 1\n");
+    return 1;
+  }
+  if (!kaso::global::checkPasses(FLAGS_passes)) {
+    return 1;
+  }
+  llvm::TargetLibraryInfoImpl::VectorLibrary vecLib;
+  if (!kaso::global::parseVecLib(FLAGS_veclib, vecLib)) {
+    return 1;
+  }
+  unsigned fastMath = 0;
+  if (!kaso::global::parseFastMath(FLAGS_fast_math, fastMath)) {
+    return 1;
+  }
+  kaso::global::setFastMath(fastMath);
 
-  kaso::shell::Shell myShell;
+  kaso::global::Target target;
+  target.cpu = FLAGS_mcpu;
+  target.features = FLAGS_mattr;
+  kaso::global::setTarget(target);
+  if (!kaso::global::checkTarget()) {
+    return 1;
+  }
+
+  kaso::global::Pipeline pipeline;
+  pipeline.level = FLAGS_opt;
+  pipeline.passes = FLAGS_passes;
+  pipeline.vecLib = FLAGS_veclib;
+  kaso::shell::Shell myShell(FLAGS_input, FLAGS_jobs, FLAGS_interpret,
+                             FLAGS_tier_threshold, pipeline,
+                             FLAGS_module_items);
   myShell.repl(FLAGS_verbose);
 
   gflags::ShutDownCommandLineFlags();
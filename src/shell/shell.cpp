@@ -1,5 +1,17 @@
 #include "shell.h"
+#include <llvm/ADT/DenseSet.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/StringExtras.h>
+#include <llvm/ADT/StringSet.h>
+#include <llvm/Support/LineIterator.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <algorithm>
 #include <iostream>
+#include <string>
+#include "batch/Batch.h"
+#include "global/Target.h"
+#include "interp/Interpreter.h"
+#include "memo/Memo.h"
 
 /// putchard - putchar that takes a double and returns 0.
 extern "C" double putchard(double X) {
@@ -16,14 +28,47 @@ extern "C" double printd(double X) {
 namespace kaso {
 namespace shell {
 
-Shell::Shell() {
-  lexer::Lexer lex(std::cin);
-  myParser_ = std::make_unique<parser::Parser>(lex);
+Shell::Shell(const std::string& input, unsigned jobs, bool interpret,
+             unsigned tierThreshold, global::Pipeline pipeline,
+             unsigned moduleItems)
+    : jobs_(jobs),
+      interpret_(interpret),
+      tierThreshold_(tierThreshold),
+      pipeline_(std::move(pipeline)),
+      moduleItems_(moduleItems) {
+  if (input.empty()) {
+    moduleItems_ = 1;
+    lexer::Lexer lex(std::cin);
+    myParser_ = std::make_unique<parser::Parser>(lex);
+    return;
+  }
+
+  auto file = lexer::loadSource(input);
+  if (file == nullptr) {
+    file = llvm::MemoryBuffer::getMemBuffer("");
+  }
+  tokens_ = std::make_shared<const lexer::TokenBuffer>(std::move(file));
+  myParser_ = std::make_unique<parser::Parser>(tokens_);
 }
 
 void Shell::repl(bool verbose) {
   global::init();
-  global::initModuleAndPassManager();
+  global::setPipeline(pipeline_);
+  if (tierThreshold_ != 0) {
+    tiering_ = std::make_unique<tier::Tiering>(
+        tierThreshold_,
+        [this](const tier::Profile& p) { return emitOptimized(p); });
+  }
+  global::initModuleAndPassManager(tiering_ == nullptr);
+
+  if (tokens_ != nullptr && jobs_ != 1) {
+    runBatch(verbose);
+    flush(verbose);
+    if (verbose) {
+      global::gModule()->print(llvm::errs(), nullptr);
+    }
+    return;
+  }
 
   fprintf(stderr, "ready> ");
   myParser_->getNextToken();
@@ -42,29 +87,524 @@ void Shell::repl(bool verbose) {
       case lexer::Token::Extern:
         handleExtern(verbose);
         break;
+      case lexer::Token::Command:
+        // run it before reading on, which would wait for more input.
+        runCommand(myParser_->curText().str(), verbose);
+        fprintf(stderr, "ready> ");
+        myParser_->getNextToken();
+        break;
       default:
         handleTopLevelExpression(verbose);
         break;
     }
   }
+  flush(verbose);
 
   if (verbose) {
     global::gModule()->print(llvm::errs(), nullptr);
   }
 }
 
-void Shell::handleDefinition(bool verbose) {
-  auto fn = myParser_->definition();
-  if (fn != nullptr) {
-    if (auto fnIR = fn->codeGen()) {
-      if (verbose) {
-        fprintf(stderr, "Read function definition: ");
-        fnIR->print(llvm::errs());
-        fprintf(stderr, "\n");
+llvm::SmallVector<llvm::orc::KaleidoscopeJIT::ModuleHandleT, 2>
+Shell::addDefinition(std::unique_ptr<parser::Function> fn, uint64_t hash,
+                     bool verbose) {
+  auto name = fn->getName();
+  tier::Profile* profile = nullptr;
+  if (tiering_ != nullptr) {
+    profile = tiering_->instrument(
+        *global::gModule()->getFunction(lexer::symbolName(name)));
+  }
+
+  llvm::SmallVector<llvm::orc::KaleidoscopeJIT::ModuleHandleT, 2> old;
+  auto it = defs_.find(name);
+  if (it != defs_.end()) {
+    // remembered results may have come from the old version.
+    memo::clearAll();
+    if (auto handle = modules_.release(it->second.module)) {
+      old.push_back(*handle);
+    }
+    if (it->second.profile != nullptr) {
+      if (auto optimized = tiering_->retire(*it->second.profile)) {
+        old.push_back(*optimized);
+      }
+    }
+  }
+  defs_[name] = {hash,    fn->callees(), numCompiled_++,
+                 0,       profile,       fn->getProto().getArgs().size(),
+                 fn->source()};
+  pendingDefs_.push_back(name);
+  if (pendingDefs_.size() + pendingExprs_.size() >= moduleItems_) {
+    flush(verbose);
+  }
+  return old;
+}
+
+std::unique_ptr<parser::Function> Shell::reparse(const Definition& def) {
+  parser::Parser par(def.source.tokens, def.source.begin, def.source.end);
+  par.operators() = myParser_->operators();
+  par.getNextToken();
+  return par.definition();
+}
+
+void Shell::prepare(lexer::Symbol name, bool verbose) {
+  if (defs_.count(name) != 0) {
+    flush(verbose);
+  }
+}
+
+namespace {
+
+// Moves the functions of m named in symbols to a module of their own, which
+// declares what they call. Nothing in m may call them. Local definitions
+// they may use are copied along.
+std::unique_ptr<llvm::Module> takeFunctions(llvm::Module& m,
+                                            const llvm::StringSet<>& symbols) {
+  llvm::ValueToValueMapTy vmap;
+  auto out = llvm::CloneModule(&m, vmap, [&](const llvm::GlobalValue* gv) {
+    return symbols.count(gv->getName()) != 0 || gv->hasLocalLinkage();
+  });
+  for (auto& symbol : symbols) {
+    m.getFunction(symbol.getKey())->eraseFromParent();
+  }
+  return out;
+}
+
+}  // namespace
+
+void Shell::flush(bool verbose) {
+  auto defs = std::move(pendingDefs_);
+  auto exprs = std::move(pendingExprs_);
+  pendingDefs_.clear();
+  pendingExprs_.clear();
+  llvm::StringSet<> symbols;
+  for (auto& e : exprs) {
+    if (e.fn == nullptr) {
+      symbols.insert(e.symbol);
+    }
+  }
+  global::JitModules::Handle exprHandle{};
+  if (!defs.empty() || !symbols.empty()) {
+    auto m = global::takeModule();
+    global::initModuleAndPassManager(tiering_ == nullptr);
+    // the definitions stay as long as one of them is current, the
+    // expressions only until they have run.
+    std::unique_ptr<llvm::Module> exprModule;
+    if (defs.empty()) {
+      exprModule = std::move(m);
+    } else {
+      if (!symbols.empty()) {
+        exprModule = takeFunctions(*m, symbols);
+      }
+      auto module =
+          modules_.add(global::gJIT()->addModule(std::move(m)), defs.size());
+      for (auto name : defs) {
+        auto& def = defs_[name];
+        def.module = module;
+        if (def.profile != nullptr) {
+          tiering_->linked(*def.profile);
+        }
+      }
+    }
+    if (exprModule != nullptr) {
+      exprHandle = global::gJIT()->addModule(std::move(exprModule));
+    }
+  }
+
+  for (auto& e : exprs) {
+    if (e.fn != nullptr) {
+      runExpression(std::move(e.fn), verbose);
+      continue;
+    }
+    auto sym = global::gJIT()->findSymbol(e.symbol);
+    assert(sym && "Function not found");
+    using FP = double (*)();
+    auto fp = (FP)(intptr_t)llvm::cantFail(sym.getAddress());
+    auto val = fp();
+    if (verbose) {
+      fprintf(stderr, "Evaluated to %f\n", val);
+    }
+    if (tiering_ != nullptr) {
+      tiering_->poll();
+    }
+  }
+
+  if (!symbols.empty()) {
+    global::gJIT()->removeModule(exprHandle);
+  }
+}
+
+std::unique_ptr<llvm::Module> Shell::emitOptimized(const tier::Profile& p) {
+  auto def = defs_.find(p.name);
+  if (def == defs_.end() || def->second.profile != &p) {
+    return nullptr;
+  }
+  for (auto callee : def->second.callees) {
+    auto c = defs_.find(callee);
+    if (c != defs_.end() && c->second.order > def->second.order) {
+      return nullptr;
+    }
+  }
+
+  auto fn = reparse(def->second);
+  if (fn == nullptr) {
+    return nullptr;
+  }
+  global::SavedModule saved;
+  global::initModuleAndPassManager(false, true);
+  std::unique_ptr<llvm::Module> m;
+  if (fn->codeGen(myParser_->operators()) != nullptr) {
+    m = std::move(global::gModule());
+  }
+  return m;
+}
+
+void Shell::runBatch(bool verbose) {
+  auto items = parser::parseBatch(tokens_, jobs_, myParser_->operators());
+  for (auto& item : items) {
+    switch (item.kind) {
+      case parser::ParsedItem::Kind::Definition:
+        compileDefinition(std::move(item.fn), verbose);
+        break;
+      case parser::ParsedItem::Kind::Extern:
+        compileExtern(std::move(item.proto), verbose);
+        break;
+      case parser::ParsedItem::Kind::Expression:
+        compileTopLevelExpression(std::move(item.fn), verbose);
+        break;
+      case parser::ParsedItem::Kind::Command:
+        runCommand(tokens_->text(item.begin), verbose);
+        break;
+    }
+  }
+}
+
+void Shell::runCommand(llvm::StringRef line, bool verbose) {
+  // commands see, and %batch calls, everything before them.
+  flush(verbose);
+  auto cmd = line.drop_front().trim().split(' ');
+  if (cmd.first == "flush") {
+    return;
+  }
+  if (cmd.first == "load") {
+    load(cmd.second.trim().str(), verbose);
+  } else if (cmd.first == "batch") {
+    auto args = cmd.second.trim().split(' ');
+    batch(lexer::intern(args.first), args.second.trim().str(), verbose);
+  } else if (cmd.first == "memo") {
+    memoStats();
+  } else if (cmd.first == "features") {
+    features();
+  } else {
+    logError("unknown command");
+  }
+}
+
+namespace {
+
+// name a 'def' or 'extern' starting at token begin will define.
+lexer::Symbol itemName(const lexer::TokenBuffer& tokens, size_t begin) {
+  auto head = tokens.kind(begin) == lexer::Token::Def
+                  ? parser::prototypeStart(tokens, begin)
+                  : begin + 1;
+  auto kind = tokens.kind(head);
+  if (kind == lexer::Token::Identifier) {
+    return tokens.symVal(head);
+  }
+  if (kind == lexer::Token::Binary || kind == lexer::Token::Unary) {
+    return parser::operatorFunctionName(tokens.kind(head + 1),
+                                        kind == lexer::Token::Binary);
+  }
+  return lexer::kNoSymbol;
+}
+
+}  // namespace
+
+void Shell::load(const std::string& path, bool verbose) {
+  auto file = lexer::loadSource(path);
+  if (file == nullptr) {
+    return;
+  }
+  auto tokens = std::make_shared<const lexer::TokenBuffer>(std::move(file));
+
+  struct Item {
+    size_t begin, end;
+    uint64_t hash;
+    lexer::Symbol name;
+  };
+  std::vector<Item> items;
+  llvm::DenseMap<lexer::Symbol, size_t> lastDef;
+  auto& starts = tokens->itemStarts();
+  for (size_t i = 0; i != starts.size(); ++i) {
+    auto end = i + 1 != starts.size() ? starts[i + 1] : tokens->size() - 1;
+    auto name = lexer::kNoSymbol;
+    if (tokens->kind(starts[i]) == lexer::Token::Def) {
+      name = itemName(*tokens, starts[i]);
+      if (name != lexer::kNoSymbol) {
+        lastDef[name] = items.size();
+      }
+    }
+    items.push_back({starts[i], end, tokens->hash(starts[i], end), name});
+  }
+
+  // the changed definitions and everything that calls them.
+  llvm::DenseMap<lexer::Symbol, llvm::SmallVector<lexer::Symbol, 4>> callers;
+  for (auto& d : defs_) {
+    for (auto callee : d.second.callees) {
+      callers[callee].push_back(d.first);
+    }
+  }
+  llvm::DenseSet<lexer::Symbol> changed;
+  for (auto& it : lastDef) {
+    auto def = defs_.find(it.first);
+    if (def == defs_.end() || def->second.hash != items[it.second].hash) {
+      changed.insert(it.first);
+    }
+  }
+  llvm::DenseSet<lexer::Symbol> stale = changed;
+  llvm::SmallVector<lexer::Symbol, 16> work(changed.begin(), changed.end());
+  while (!work.empty()) {
+    for (auto caller : callers[work.pop_back_val()]) {
+      if (stale.insert(caller).second) {
+        work.push_back(caller);
+      }
+    }
+  }
+  auto callsStale = [&](const std::vector<lexer::Symbol>& callees) {
+    return std::any_of(callees.begin(), callees.end(),
+                       [&](lexer::Symbol c) { return stale.count(c) != 0; });
+  };
+
+  // parse and compile what changed, in source order. Expressions and
+  // commands run once every new definition is in the JIT.
+  auto& ops = myParser_->operators();
+  llvm::DenseSet<lexer::Symbol> emitted;
+  std::vector<llvm::orc::KaleidoscopeJIT::ModuleHandleT> replaced;
+  std::vector<Item> deferred;
+  size_t parsed = 0;
+  for (size_t i = 0; i != items.size(); ++i) {
+    auto& item = items[i];
+    auto kind = tokens->kind(item.begin);
+    if (kind == lexer::Token::Def) {
+      // a malformed 'def' is parsed anyway, to report the error.
+      if (item.name != lexer::kNoSymbol && lastDef[item.name] == i &&
+          !changed.count(item.name)) {
+        // the same tokens, so the old buffer can go.
+        defs_[item.name].source = {tokens, item.begin, item.end};
+      }
+      if (item.name != lexer::kNoSymbol &&
+          (!changed.count(item.name) || lastDef[item.name] != i)) {
+        continue;
       }
-      global::gJIT()->addModule(std::move(global::gModule()));
-      global::initModuleAndPassManager();
+    } else {
+      auto seen = loaded_.find(item.hash);
+      if (seen != loaded_.end() && !callsStale(seen->second)) {
+        continue;
+      }
+      if (kind != lexer::Token::Extern) {
+        deferred.push_back(item);
+        continue;
+      }
+    }
+
+    parsed++;
+    parser::Parser par(tokens, item.begin, item.end);
+    par.operators() = ops;
+    par.getNextToken();
+    if (kind == lexer::Token::Extern) {
+      if (auto proto = par.externDef()) {
+        compileExtern(std::move(proto), verbose);
+        loaded_[item.hash] = {};
+      }
+      continue;
+    }
+    auto fn = par.definition();
+    if (fn == nullptr || item.name == lexer::kNoSymbol) {
+      continue;
+    }
+    checkPurity(*fn);
+    prepare(item.name, verbose);
+    if (fn->codeGen(ops) == nullptr) {
+      continue;
+    }
+    auto old = addDefinition(std::move(fn), item.hash, verbose);
+    replaced.insert(replaced.end(), old.begin(), old.end());
+    emitted.insert(item.name);
+  }
+
+  // callers that did not change are parsed and compiled again, callees
+  // first as far as the compile order tells.
+  std::vector<std::pair<size_t, lexer::Symbol>> callersToEmit;
+  for (auto name : stale) {
+    auto def = defs_.find(name);
+    if (!emitted.count(name) && def != defs_.end()) {
+      callersToEmit.push_back({def->second.order, name});
+    }
+  }
+  std::sort(callersToEmit.begin(), callersToEmit.end());
+  for (auto& caller : callersToEmit) {
+    prepare(caller.second, verbose);
+    auto hash = defs_[caller.second].hash;
+    auto fn = reparse(defs_[caller.second]);
+    if (fn == nullptr) {
+      continue;
+    }
+    checkPurity(*fn);
+    if (fn->codeGen(ops) == nullptr) {
+      continue;
+    }
+    auto old = addDefinition(std::move(fn), hash, verbose);
+    replaced.insert(replaced.end(), old.begin(), old.end());
+    emitted.insert(caller.second);
+  }
+
+  // nothing resolves to the old versions any more.
+  flush(verbose);
+  for (auto handle : replaced) {
+    global::gJIT()->removeModule(handle);
+  }
+
+  for (auto& item : deferred) {
+    parsed++;
+    parser::Parser par(tokens, item.begin, item.end);
+    par.operators() = ops;
+    par.getNextToken();
+    auto& callees = loaded_[item.hash];
+    callees.clear();
+    if (par.curToken() == lexer::Token::Command) {
+      runCommand(par.curText(), verbose);
+      continue;
+    }
+    while (par.curToken() != lexer::Token::Eof) {
+      if (par.curToken() == lexer::Token::Semicolon) {
+        par.getNextToken();
+      } else if (auto fn = par.topLevelExpr()) {
+        auto called = fn->callees();
+        callees.insert(callees.end(), called.begin(), called.end());
+        compileTopLevelExpression(std::move(fn), verbose);
+      } else {
+        par.getNextToken();
+      }
+    }
+  }
+  flush(verbose);
+
+  if (verbose) {
+    fprintf(stderr, "Loaded %s: %zu items, %zu parsed, %zu compiled\n",
+            path.c_str(), items.size(), parsed, emitted.size());
+  }
+}
+
+void Shell::batch(lexer::Symbol name, const std::string& path,
+                  bool verbose) {
+  auto def = defs_.find(name);
+  if (def == defs_.end()) {
+    logError("Unknown function referenced");
+    return;
+  }
+  auto file = lexer::loadSource(path);
+  if (file == nullptr) {
+    return;
+  }
+
+  auto arity = def->second.arity;
+  std::vector<std::vector<double>> columns(arity);
+  size_t rows = 0;
+  for (llvm::line_iterator line(*file); !line.is_at_eof(); ++line) {
+    size_t k = 0;
+    for (auto field = llvm::getToken(*line, " \t\r,"); !field.first.empty();
+         field = llvm::getToken(field.second, " \t\r,")) {
+      double val;
+      if (k == arity) {
+        logError("Incorrect # arguments passed");
+        return;
+      }
+      if (field.first.getAsDouble(val)) {
+        logError(("line " + std::to_string(line.line_number()) + ": " +
+                  field.first.str() + " is not a number")
+                     .c_str());
+        return;
+      }
+      columns[k++].push_back(val);
+    }
+    if (k != 0 && k != arity) {
+      logError("Incorrect # arguments passed");
+      return;
+    }
+    if (k != 0 || arity == 0) {
+      rows++;
+    }
+  }
+
+  auto fn = reparse(def->second);
+  if (fn == nullptr) {
+    return;
+  }
+  auto wrapper = batch::Batch::compile(*fn, myParser_->operators());
+  if (wrapper == nullptr) {
+    return;
+  }
+  std::vector<const double*> starts;
+  for (auto& column : columns) {
+    starts.push_back(column.data());
+  }
+  std::vector<double> out(rows);
+  wrapper->run(starts.data(), out.data(), rows);
+  for (auto val : out) {
+    printf("%f\n", val);
+  }
+  if (verbose) {
+    fprintf(stderr, "Evaluated %s on %zu rows\n",
+            lexer::symbolName(name).str().c_str(), rows);
+  }
+}
+
+void Shell::memoStats() {
+  for (auto c : memo::caches()) {
+    printf("%s: %zu of %zu entries, %llu hits, %llu misses\n",
+           lexer::symbolName(c->name()).str().c_str(), c->size(),
+           c->capacity(), static_cast<unsigned long long>(c->hits()),
+           static_cast<unsigned long long>(c->misses()));
+  }
+}
+
+void Shell::features() {
+  auto& tm = global::gJIT()->getTargetMachine();
+  printf("cpu: %s\nfeatures:", tm.getTargetCPU().str().c_str());
+  for (auto& f : global::activeFeatures(tm.getTargetFeatureString())) {
+    printf(" %s", f.c_str());
+  }
+  printf("\n");
+}
+
+void Shell::checkPurity(parser::Function& fn) {
+  if (!fn.isMemo()) {
+    return;
+  }
+  llvm::DenseSet<lexer::Symbol> seen;
+  seen.insert(fn.getName());
+  auto work = fn.callees();
+  while (!work.empty()) {
+    auto callee = work.back();
+    work.pop_back();
+    if (!seen.insert(callee).second) {
+      continue;
+    }
+    auto def = defs_.find(callee);
+    if (def == defs_.end()) {
+      fprintf(stderr, "Warning: %s is not memoized, it calls %s\n",
+              lexer::symbolName(fn.getName()).str().c_str(),
+              lexer::symbolName(callee).str().c_str());
+      fn.setMemo(false);
+      return;
     }
+    work.insert(work.end(), def->second.callees.begin(),
+                def->second.callees.end());
+  }
+}
+
+void Shell::handleDefinition(bool verbose) {
+  if (auto fn = myParser_->definition()) {
+    compileDefinition(std::move(fn), verbose);
   } else {
     myParser_->getNextToken();
   }
@@ -72,15 +612,7 @@ void Shell::handleDefinition(bool verbose) {
 
 void Shell::handleExtern(bool verbose) {
   if (auto proto = myParser_->externDef()) {
-    if (auto fnIR = proto->codeGen()) {
-      if (verbose) {
-        fprintf(stderr, "Read extern: ");
-        fnIR->print(llvm::errs());
-        fprintf(stderr, "\n");
-      }
-      auto name = proto->getName();
-      global::storeProto(name, std::move(proto));
-    }
+    compileExtern(std::move(proto), verbose);
   } else {
     myParser_->getNextToken();
   }
@@ -88,30 +620,115 @@ void Shell::handleExtern(bool verbose) {
 
 void Shell::handleTopLevelExpression(bool verbose) {
   if (auto fn = myParser_->topLevelExpr()) {
-    if (auto fnIR = fn->codeGen()) {
-      if (verbose) {
-        fprintf(stderr, "Read top-level expression:\n");
-        fnIR->print(llvm::errs());
-        fprintf(stderr, "\n");
-      }
+    compileTopLevelExpression(std::move(fn), verbose);
+  } else {
+    myParser_->getNextToken();
+  }
+}
 
-      auto handle = global::gJIT()->addModule(std::move(global::gModule()));
-      global::initModuleAndPassManager();
+void Shell::compileDefinition(std::unique_ptr<parser::Function> fn,
+                              bool verbose) {
+  checkPurity(*fn);
+  prepare(fn->getName(), verbose);
+  if (auto fnIR = fn->codeGen(myParser_->operators())) {
+    if (verbose) {
+      fprintf(stderr, "Read function definition: ");
+      fnIR->print(llvm::errs());
+      fprintf(stderr, "\n");
+    }
+    // a redefinition at the prompt leaves the old version to its callers.
+    addDefinition(std::move(fn), 0, verbose);
+  }
+}
 
-      auto exprSymbol = global::gJIT()->findSymbol("__anonymous_expr");
-      assert(exprSymbol && "Function not found");
+void Shell::compileExtern(std::unique_ptr<parser::Prototype> proto,
+                          bool verbose) {
+  prepare(proto->getName(), verbose);
+  if (auto fnIR = proto->codeGen()) {
+    if (verbose) {
+      fprintf(stderr, "Read extern: ");
+      fnIR->print(llvm::errs());
+      fprintf(stderr, "\n");
+    }
+    auto name = proto->getName();
+    global::storeProto(name, std::move(proto));
+  }
+}
 
-      auto addr = exprSymbol.getAddress();
-      using FP = double (*)();
-      auto fp = (FP)(intptr_t)llvm::cantFail(std::move(addr));
-      auto val = fp();
-      if (verbose) {
-        fprintf(stderr, "Evaluated to %f\n", val);
-      }
-      global::gJIT()->removeModule(handle);
+void Shell::compileTopLevelExpression(std::unique_ptr<parser::Function> fn,
+                                      bool verbose) {
+  if (interpret_) {
+    // the interpreter links calls when it compiles, so it waits for the
+    // module like the JIT does. An unknown callee is reported right away.
+    auto callees = fn->callees();
+    auto known =
+        std::all_of(callees.begin(), callees.end(), [](lexer::Symbol c) {
+          return global::getProto(c) != nullptr;
+        });
+    if (!known) {
+      flush(verbose);
+      runExpression(std::move(fn), verbose);
+      return;
+    }
+    pendingExprs_.push_back({std::move(fn), ""});
+  } else if (auto fnIR = fn->codeGen(myParser_->operators())) {
+    if (verbose) {
+      fprintf(stderr, "Read top-level expression:\n");
+      fnIR->print(llvm::errs());
+      fprintf(stderr, "\n");
     }
+    // the next expression in the module needs the name too.
+    fnIR->setName("__anonymous_expr." +
+                  std::to_string(pendingExprs_.size()));
+    pendingExprs_.push_back({nullptr, fnIR->getName().str()});
   } else {
-    myParser_->getNextToken();
+    return;
+  }
+  if (pendingDefs_.size() + pendingExprs_.size() >= moduleItems_) {
+    flush(verbose);
+  }
+}
+
+void Shell::runExpression(std::unique_ptr<parser::Function> fn, bool verbose) {
+  if (auto prog = interp::Program::compile(*fn->getBody())) {
+    if (verbose) {
+      fprintf(stderr, "Read top-level expression:\n");
+      prog->print(llvm::errs());
+    }
+    auto val = prog->run();
+    if (verbose) {
+      fprintf(stderr, "Evaluated to %f\n", val);
+    }
+    if (tiering_ != nullptr) {
+      tiering_->poll();
+    }
+    return;
+  }
+
+  if (auto fnIR = fn->codeGen(myParser_->operators())) {
+    if (verbose) {
+      fprintf(stderr, "Read top-level expression:\n");
+      fnIR->print(llvm::errs());
+      fprintf(stderr, "\n");
+    }
+
+    auto handle = global::gJIT()->addModule(global::takeModule());
+    global::initModuleAndPassManager(tiering_ == nullptr);
+
+    auto exprSymbol = global::gJIT()->findSymbol("__anonymous_expr");
+    assert(exprSymbol && "Function not found");
+
+    auto addr = exprSymbol.getAddress();
+    using FP = double (*)();
+    auto fp = (FP)(intptr_t)llvm::cantFail(std::move(addr));
+    auto val = fp();
+    if (verbose) {
+      fprintf(stderr, "Evaluated to %f\n", val);
+    }
+    global::gJIT()->removeModule(handle);
+    if (tiering_ != nullptr) {
+      tiering_->poll();
+    }
   }
 }
 
@@ -1,24 +1,144 @@
 #pragma once
 
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
+#include <unordered_map>
+#include <vector>
+#include "global/JitModules.h"
+#include "global/Optimize.h"
+#include "parser/BatchParser.h"
 #include "parser/Parser.h"
+#include "tier/Tiering.h"
 
 namespace kaso {
 namespace shell {
 
 class Shell {
  public:
-  Shell();
+  /// Reads from stdin when input is empty, otherwise tokenizes the whole file
+  /// up front. A file is parsed on jobs threads (0 for one per core) before
+  /// anything is compiled, unless jobs is 1. Top-level expressions run on the
+  /// bytecode interpreter when interpret is set and it supports them. With a
+  /// tierThreshold definitions start out unoptimized and are recompiled at
+  /// O3 after that many calls, see tier::Tiering. Optimized code, right away
+  /// or in the background, goes through pipeline. A file compiles up to
+  /// moduleItems definitions and expressions into one module before handing
+  /// it to the JIT and running the expressions, see flush(); stdin compiles
+  /// and runs every item on its own.
+  explicit Shell(const std::string& input = "", unsigned jobs = 1,
+                 bool interpret = true, unsigned tierThreshold = 0,
+                 global::Pipeline pipeline = global::Pipeline(),
+                 unsigned moduleItems = 1);
 
-  /// top ::= definition | external | expression | ';'
+  /// top ::= definition | external | expression | command | ';'
   void repl(bool verbose);
 
  private:
+  /// A compiled definition. Its AST is freed once it is emitted; what it
+  /// calls and where it came from are kept to emit it again when a function
+  /// it calls is reloaded, for the O3 tier and for %batch.
+  struct Definition {
+    uint64_t hash;  // of its tokens if it came from %load, otherwise 0
+    std::vector<lexer::Symbol> callees;
+    size_t order;  // when it was compiled, callees usually come first
+    size_t module;  // index into modules_, once flushed
+    tier::Profile* profile;  // nullptr without tiering
+    size_t arity;
+    parser::Source source;
+  };
+
+  /// A top-level expression waiting for the current module.
+  struct Expression {
+    std::unique_ptr<parser::Function> fn;  // to interpret, or nullptr
+    std::string symbol;  // of its code in the module otherwise
+  };
+
+  /// Records fn, just emitted into the current module, and counts it
+  /// towards moduleItems. Returns the modules fn's previous version lives
+  /// in, if nothing else does.
+  llvm::SmallVector<llvm::orc::KaleidoscopeJIT::ModuleHandleT, 2>
+  addDefinition(std::unique_ptr<parser::Function> fn, uint64_t hash,
+                bool verbose);
+
+  /// Parses def again from its source, with the operators defined by now.
+  std::unique_ptr<parser::Function> reparse(const Definition& def);
+
+  /// Flushes before name is emitted again: callers already in the module,
+  /// and expressions waiting for it, must get the version they were
+  /// compiled against.
+  void prepare(lexer::Symbol name, bool verbose);
+
+  /// Hands the current module to the JIT, if it has code in it, then runs
+  /// the expressions waiting for it in order. Their code goes to a module
+  /// of its own, removed once they have run.
+  void flush(bool verbose);
+
+  /// Interprets fn, or compiles it into a module of its own, and runs it.
+  void runExpression(std::unique_ptr<parser::Function> fn, bool verbose);
+
+  /// Emits the definition p counts calls for again, to be optimized. Not if
+  /// it was redefined, or one of its callees was, since it would then call
+  /// the new version.
+  std::unique_ptr<llvm::Module> emitOptimized(const tier::Profile& p);
+
+  void runBatch(bool verbose);
+
+  /// %name arguments. Flushes first, and %flush does nothing else.
+  void runCommand(llvm::StringRef line, bool verbose);
+
+  /// %load path: runs a script, or reruns it after an edit. Definitions whose
+  /// tokens did not change are skipped without parsing. Changed ones are
+  /// compiled again together with every definition that calls them, directly
+  /// or not, parsed again from where it came from, and the modules they
+  /// replace are removed. Expressions run when they are new or call a
+  /// recompiled definition.
+  void load(const std::string& path, bool verbose);
+
+  /// %batch name path: calls name on every row of path, whitespace or comma
+  /// separated with a column per argument, through a vectorized
+  /// batch::Batch, and prints a result per row to stdout.
+  void batch(lexer::Symbol name, const std::string& path, bool verbose);
+
+  /// %memo: prints the size, hits and misses of every memo cache to stdout.
+  void memoStats();
+
+  /// %features: prints the CPU JIT code is compiled for and the features
+  /// turned on explicitly, every one the host has by default, to stdout.
+  void features();
+
+  /// Drops the memo annotation of fn, with a warning, unless everything it
+  /// calls, directly or not, is a definition. An extern may have side
+  /// effects that answering from the cache would skip.
+  void checkPurity(parser::Function& fn);
+
   void handleDefinition(bool verbose);
   void handleExtern(bool verbose);
   void handleTopLevelExpression(bool verbose);
 
+  void compileDefinition(std::unique_ptr<parser::Function> fn, bool verbose);
+  void compileExtern(std::unique_ptr<parser::Prototype> proto, bool verbose);
+  void compileTopLevelExpression(std::unique_ptr<parser::Function> fn,
+                                 bool verbose);
+
  private:
   std::unique_ptr<parser::Parser> myParser_;
+  std::shared_ptr<const lexer::TokenBuffer> tokens_;
+  unsigned jobs_;
+  bool interpret_;
+  unsigned tierThreshold_;
+  global::Pipeline pipeline_;
+  std::unique_ptr<tier::Tiering> tiering_;
+
+  llvm::DenseMap<lexer::Symbol, Definition> defs_;
+  size_t numCompiled_ = 0;
+  global::JitModules modules_;
+
+  unsigned moduleItems_;
+  /// definitions and expressions in the current module, in order.
+  std::vector<lexer::Symbol> pendingDefs_;
+  std::vector<Expression> pendingExprs_;
+  /// callees of the externs, expressions and commands %load has run, by hash.
+  std::unordered_map<uint64_t, std::vector<lexer::Symbol>> loaded_;
 };
 
 }  // namespace shell
@@ -0,0 +1,179 @@
+#include "tier/Tiering.h"
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/MDBuilder.h>
+#include <limits>
+#include "global/Global.h"
+#include "global/Optimize.h"
+#include "global/Target.h"
+
+namespace kaso {
+namespace tier {
+
+namespace {
+
+const uint64_t kNever = std::numeric_limits<uint64_t>::max();
+
+// the baseline code calls this with the address of its profile.
+void onHot(uint64_t profile) {
+  auto p = reinterpret_cast<Profile*>(profile);
+  p->owner->hot(*p);
+}
+
+}  // namespace
+
+Tiering::Tiering(unsigned threshold, EmitFn emit)
+    : threshold_(threshold),
+      emit_(std::move(emit)),
+      tm_(global::createTargetMachine()),
+      worker_([this] { work(); }) {}
+
+Tiering::~Tiering() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  worker_.join();
+}
+
+Profile* Tiering::instrument(llvm::Function& f) {
+  profiles_.push_back(std::make_unique<Profile>());
+  auto p = profiles_.back().get();
+  p->name = lexer::intern(f.getName());
+  p->next = threshold_;
+  p->owner = this;
+
+  auto& ctx = f.getContext();
+  llvm::IRBuilder<> b(ctx);
+  auto i64 = b.getInt64Ty();
+  auto host = [&](const void* ptr, llvm::Type* type) {
+    return b.CreateIntToPtr(b.getInt64(reinterpret_cast<uintptr_t>(ptr)),
+                            type->getPointerTo());
+  };
+
+  // callers, including f itself, go through the stub from now on.
+  auto name = f.getName().str();
+  f.setName(name + ".baseline");
+  auto stub = llvm::Function::Create(f.getFunctionType(),
+                                     llvm::Function::ExternalLinkage, name,
+                                     f.getParent());
+  f.replaceAllUsesWith(stub);
+  b.SetInsertPoint(llvm::BasicBlock::Create(ctx, "entry", stub));
+  auto target = b.CreateLoad(f.getType(), host(&p->target, f.getType()));
+  llvm::SmallVector<llvm::Value*, 8> args;
+  for (auto& arg : stub->args()) {
+    args.push_back(&arg);
+  }
+  auto call = b.CreateCall(f.getFunctionType(), target, args);
+  call->setTailCallKind(llvm::CallInst::TCK_MustTail);
+  b.CreateRet(call);
+
+  // calls += 1; if (calls >= next) onHot(p);
+  auto& entry = f.getEntryBlock();
+  auto body = entry.splitBasicBlock(entry.begin(), "body");
+  entry.getTerminator()->eraseFromParent();
+  b.SetInsertPoint(&entry);
+  auto callsPtr = host(&p->calls, i64);
+  auto calls = b.CreateAdd(b.CreateLoad(i64, callsPtr), b.getInt64(1));
+  b.CreateStore(calls, callsPtr);
+  auto isHot = b.CreateICmpUGE(calls, b.CreateLoad(i64, host(&p->next, i64)));
+  auto hot = llvm::BasicBlock::Create(ctx, "hot", &f, body);
+  b.CreateCondBr(isHot, hot, body,
+                 llvm::MDBuilder(ctx).createBranchWeights(1, 1 << 20));
+  b.SetInsertPoint(hot);
+  auto hookType = llvm::FunctionType::get(b.getVoidTy(), {i64}, false);
+  b.CreateCall(hookType, host(reinterpret_cast<const void*>(&onHot), hookType),
+               {b.getInt64(reinterpret_cast<uintptr_t>(p))});
+  b.CreateBr(body);
+  return p;
+}
+
+void Tiering::linked(Profile& p) {
+  auto sym =
+      global::gJIT()->findSymbol(lexer::symbolName(p.name).str() + ".baseline");
+  p.target = llvm::cantFail(sym.getAddress());
+}
+
+llvm::Optional<llvm::orc::KaleidoscopeJIT::ModuleHandleT> Tiering::retire(
+    Profile& p) {
+  p.state = Profile::State::Retired;
+  p.next = kNever;
+  auto optimized = p.optimized;
+  p.optimized = llvm::None;
+  return optimized;
+}
+
+void Tiering::hot(Profile& p) {
+  p.next = p.calls + threshold_;
+  if (p.state == Profile::State::Baseline) {
+    auto m = emit_(p);
+    if (m == nullptr) {
+      p.next = kNever;
+      return;
+    }
+    std::string bitcode;
+    llvm::raw_string_ostream os(bitcode);
+    llvm::WriteBitcodeToFile(m.get(), os);
+    os.flush();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      jobs_.push_back({&p, std::move(bitcode)});
+    }
+    wake_.notify_one();
+    p.state = Profile::State::Compiling;
+  }
+  poll();
+}
+
+void Tiering::poll() {
+  std::vector<Done> done;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    done.swap(done_);
+  }
+  for (auto& d : done) {
+    auto& p = *d.profile;
+    if (p.state != Profile::State::Compiling) {
+      continue;
+    }
+    p.optimized = global::gJIT()->addObject(std::move(d.object));
+    auto sym = global::gJIT()->findSymbol(lexer::symbolName(p.name).str());
+    p.target = llvm::cantFail(sym.getAddress());
+    p.state = Profile::State::Optimized;
+    p.next = kNever;
+  }
+}
+
+void Tiering::work() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+      if (stop_) {
+        return;
+      }
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+    }
+
+    llvm::LLVMContext ctx;
+    auto m = llvm::parseBitcodeFile(
+        llvm::MemoryBufferRef(job.bitcode, "optimized"), ctx);
+    if (!m) {
+      llvm::consumeError(m.takeError());
+      continue;
+    }
+    global::optimize(**m, *tm_, global::pipeline());
+    auto object = llvm::orc::SimpleCompiler(*tm_)(**m);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_.push_back({job.profile, std::move(object)});
+  }
+}
+
+}  // namespace tier
+}  // namespace kaso
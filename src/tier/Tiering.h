@@ -0,0 +1,101 @@
+#pragma once
+
+#include <llvm/ADT/Optional.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Object/ObjectFile.h>
+#include <llvm/Target/TargetMachine.h>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "KaleidoscopeJIT.h"
+#include "lexer/Symbol.h"
+
+namespace kaso {
+namespace tier {
+
+class Tiering;
+
+/// What the baseline code of a definition shares with the host. Its address
+/// is baked into that code, so it lives as long as the Tiering does.
+struct Profile {
+  enum class State : uint8_t { Baseline, Compiling, Optimized, Retired };
+
+  uint64_t calls = 0;
+  /// calls at which the baseline code calls back into the host.
+  uint64_t next;
+  /// where the stub under the definition's name jumps to.
+  uint64_t target = 0;
+  lexer::Symbol name;
+  State state = State::Baseline;
+  Tiering* owner;
+  llvm::Optional<llvm::orc::KaleidoscopeJIT::ModuleHandleT> optimized;
+};
+
+/// Two-tier compilation. Definitions are emitted without optimization, with
+/// a call counter in front and a stub under their own name that jumps to
+/// the current code. Once a definition has been called threshold times its
+/// IR is emitted again and handed to a worker thread, which optimizes it
+/// with global::pipeline() and compiles it to an object in a context of its
+/// own. The object is linked and the stub retargeted on the main thread, the
+/// next time the counter calls back or at poll().
+class Tiering {
+ public:
+  /// Emits the IR of a definition into a module of its own, or returns
+  /// nullptr to keep the baseline code.
+  using EmitFn = std::function<std::unique_ptr<llvm::Module>(const Profile&)>;
+
+  Tiering(unsigned threshold, EmitFn emit);
+  ~Tiering();
+
+  /// Instruments f, a definition in the current module: it is renamed and
+  /// gets the counter, and a stub takes its name and its callers. Call
+  /// linked() once the module is in the JIT.
+  Profile* instrument(llvm::Function& f);
+
+  /// Points the stub at the baseline code.
+  void linked(Profile& p);
+
+  /// p was redefined. Returns the module with its optimized code, which the
+  /// caller removes once nothing calls it any more.
+  llvm::Optional<llvm::orc::KaleidoscopeJIT::ModuleHandleT> retire(Profile& p);
+
+  /// Links the code the worker has finished.
+  void poll();
+
+  /// Called from the baseline code of p once it has run p.next times.
+  void hot(Profile& p);
+
+ private:
+  struct Job {
+    Profile* profile;
+    std::string bitcode;
+  };
+  struct Done {
+    Profile* profile;
+    llvm::object::OwningBinary<llvm::object::ObjectFile> object;
+  };
+
+  void work();
+
+  unsigned threshold_;
+  EmitFn emit_;
+  std::vector<std::unique_ptr<Profile>> profiles_;
+
+  std::unique_ptr<llvm::TargetMachine> tm_;  // the worker's
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::deque<Job> jobs_;
+  std::vector<Done> done_;
+  bool stop_ = false;
+  std::thread worker_;
+};
+
+}  // namespace tier
+}  // namespace kaso
@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <llvm/IR/Instructions.h>
+#include <vector>
+#include "batch/Batch.h"
+#include "global/Global.h"
+#include "parser/Parser.h"
+
+namespace kaso {
+namespace batch {
+
+TEST(BatchTest, ColumnsTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def f(x y) if x < y then x * y + 1 else y - x;"));
+  par.getNextToken();
+  auto fn = par.definition();
+  ASSERT_NE(fn, nullptr);
+
+  auto wrapper = Batch::compile(*fn, par.operators());
+  ASSERT_NE(wrapper, nullptr);
+  ASSERT_EQ(wrapper->arity(), 2);
+  // the module being filled is left as it was.
+  ASSERT_TRUE(global::gModule()->empty());
+
+  const uint64_t n = 1001;
+  std::vector<double> x(n), y(n), out(n + 1, -1);
+  for (uint64_t i = 0; i < n; i++) {
+    x[i] = i % 7;
+    y[i] = i % 5;
+  }
+  const double* columns[] = {x.data(), y.data()};
+  wrapper->run(columns, out.data(), n);
+  for (uint64_t i = 0; i < n; i++) {
+    ASSERT_EQ(out[i], x[i] < y[i] ? x[i] * y[i] + 1 : y[i] - x[i]);
+  }
+  ASSERT_EQ(out[n], -1);
+  wrapper->run(columns, out.data(), 0);
+}
+
+TEST(BatchTest, SavedModuleTest) {
+  global::init();
+  auto compile = [](const std::string& src) {
+    parser::Parser par(std::make_shared<const lexer::TokenBuffer>(src));
+    par.getNextToken();
+    auto fn = par.definition();
+    EXPECT_NE(fn, nullptr);
+    EXPECT_NE(Batch::compile(*fn, par.operators()), nullptr);
+  };
+  auto define = [](const std::string& src) {
+    parser::Parser par(std::make_shared<const lexer::TokenBuffer>(src));
+    par.getNextToken();
+    auto fn = par.definition();
+    ASSERT_NE(fn, nullptr);
+    ASSERT_NE(fn->codeGen(par.operators()), nullptr);
+  };
+  auto calls = [](const llvm::Module& m, const char* name) {
+    size_t n = 0;
+    for (auto& bb : *m.getFunction(name)) {
+      for (auto& inst : bb) {
+        n += llvm::isa<llvm::CallInst>(inst);
+      }
+    }
+    return n;
+  };
+
+  // an optimized module still gets the module pipeline, which inlines.
+  global::initModuleAndPassManager();
+  compile("def b(x) x + 1;");
+  define("def sq(x) x * x;");
+  define("def q(x) sq(x) + 1;");
+  auto m = global::takeModule();
+  ASSERT_EQ(calls(*m, "q"), 0);
+  global::gJIT()->addModule(std::move(m));
+
+  // and a baseline module still imports nothing.
+  global::initModuleAndPassManager(false);
+  compile("def b(x) x + 1;");
+  define("def r(x) sq(x) + 2;");
+  ASSERT_TRUE(global::gModule()->getFunction("sq")->isDeclaration());
+  global::initModuleAndPassManager();
+}
+
+TEST(BatchTest, MemoTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def memo fib(x) if x < 2 then x else fib(x - 1) + fib(x - 2);"));
+  par.getNextToken();
+  auto fn = par.definition();
+  ASSERT_NE(fn, nullptr);
+  ASSERT_NE(fn->codeGen(par.operators()), nullptr);
+  global::gJIT()->addModule(global::takeModule());
+  auto uncached = [] {
+    return llvm::cantFail(
+        global::gJIT()->findSymbol("fib.uncached").getAddress());
+  };
+  auto addr = uncached();
+  ASSERT_NE(addr, 0);
+
+  auto wrapper = Batch::compile(*fn, par.operators());
+  ASSERT_NE(wrapper, nullptr);
+  // the copy's uncached body does not shadow the definition's.
+  ASSERT_EQ(uncached(), addr);
+
+  std::vector<double> x = {10, 20, 1}, out(x.size());
+  const double* columns[] = {x.data()};
+  wrapper->run(columns, out.data(), x.size());
+  ASSERT_EQ(out, std::vector<double>({55, 6765, 1}));
+}
+
+}  // namespace batch
+}  // namespace kaso
@@ -0,0 +1,134 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include "global/Global.h"
+#include "interp/Interpreter.h"
+#include "parser/Parser.h"
+
+namespace kaso {
+namespace interp {
+
+namespace {
+
+// compiles src as a top-level expression, nullptr if it cannot be
+// interpreted. The parser is kept so the nodes outlive the program.
+std::unique_ptr<Program> compile(const std::string& src,
+                                 std::unique_ptr<parser::Function>& fn) {
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(src));
+  par.getNextToken();
+  fn = par.topLevelExpr();
+  return fn != nullptr ? Program::compile(*fn->getBody()) : nullptr;
+}
+
+double run(const std::string& src) {
+  std::unique_ptr<parser::Function> fn;
+  auto prog = compile(src, fn);
+  return prog != nullptr ? prog->run() : -12345;
+}
+
+}  // namespace
+
+TEST(InterpTest, ArithmeticTest) {
+  global::init();
+  ASSERT_EQ(run("1 + 2 * 3 - 4"), 3);
+  ASSERT_EQ(run("if 1 < 2 then 10 else 20"), 10);
+  ASSERT_EQ(run("if 2 < 1 then 10 else 20"), 20);
+  // a loop is 0, but runs its body and evaluates the end before stepping.
+  ASSERT_EQ(run("for i = 0, i < 10 in i"), 0);
+  ASSERT_EQ(run("for i = 1, i < 3, 0.5 in (for j = 0, j < i in j)"), 0);
+}
+
+TEST(InterpTest, VarTest) {
+  ASSERT_EQ(run("var a = 1, b in (b = a + 1) * 2"), 4);
+  // inits see the variables before them, the body sees its assignments.
+  ASSERT_EQ(run("var a = 2, b = a * 3 in a = a + b"), 8);
+  ASSERT_EQ(run("var s in (for i = 0, i < 5 in s = s + i) + s"), 15);
+  // assigning the loop variable is seen by the end condition and the step.
+  ASSERT_EQ(run("var n in (for i = 0, i < 100 in (n = n + 1) + (i = i * 2))"
+                " + n"),
+            7);
+  ASSERT_EQ(run("var x = 1 in (var x = 2 in x) + x"), 3);
+}
+
+TEST(InterpTest, NaNTest) {
+  // comparisons are unordered-or-less, conditions ordered-and-not-zero, the
+  // same as the fcmp ult and fcmp one the IR uses.
+  parser::NumberExpr nan(std::numeric_limits<double>::quiet_NaN()), one(1);
+  parser::BinaryExpr less(lexer::Token::OpLess, &nan, &one);
+  ASSERT_EQ(Program::compile(less)->run(), 1);
+  parser::IfExpr cond(&nan, &one, &nan);
+  ASSERT_TRUE(std::isnan(Program::compile(cond)->run()));
+}
+
+TEST(InterpTest, OperatorTest) {
+  // every builtin operator gives what the JIT-compiled IR gives.
+  const char* ops[] = {"+", "-", "*", "/", "<", ">", "<=",
+                       ">=", "==", "!=", "&&", "||"};
+  const char* vals[] = {"0", "0 * (0 - 1)", "1", "0 - 2.5", "0 / 0"};
+  global::init();
+  global::initModuleAndPassManager(false);
+  std::string src;
+  for (size_t i = 0; i != sizeof ops / sizeof ops[0]; ++i) {
+    src += "def op" + std::to_string(i) + "(a b) a " + ops[i] + " b;";
+  }
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(src));
+  par.getNextToken();
+  while (par.curToken() == lexer::Token::Def) {
+    auto def = par.definition();
+    ASSERT_NE(def, nullptr);
+    ASSERT_NE(def->codeGen(par.operators()), nullptr);
+    par.getNextToken();  // eat ';'
+  }
+  global::gJIT()->addModule(std::move(global::gModule()));
+  global::initModuleAndPassManager();
+
+  for (size_t i = 0; i != sizeof ops / sizeof ops[0]; ++i) {
+    auto sym = global::gJIT()->findSymbol("op" + std::to_string(i));
+    auto f = (double (*)(double, double))(intptr_t)llvm::cantFail(
+        sym.getAddress());
+    for (auto l : vals) {
+      for (auto r : vals) {
+        auto expr = std::string("var a = ") + l + ", b = " + r + " in a " +
+                    ops[i] + " b";
+        auto want = f(run(l), run(r));
+        auto got = run(expr);
+        ASSERT_TRUE(got == want || (std::isnan(got) && std::isnan(want)))
+            << expr << ": " << got << " != " << want;
+        // constant operands are folded by the simplifier instead.
+        got = run(std::string("(") + l + ") " + ops[i] + " (" + r + ")");
+        ASSERT_TRUE(got == want || (std::isnan(got) && std::isnan(want)))
+            << l << ops[i] << r << ": " << got << " != " << want;
+      }
+    }
+  }
+
+  // the right operand only runs if the left one does not decide.
+  ASSERT_EQ(run("var a, n in (a && (n = 1)) + n"), 0);
+  ASSERT_EQ(run("var a = 2, n in (a && (n = 5)) + n"), 6);
+  ASSERT_EQ(run("var a = 0/0, n in (a || (n = 0)) + n"), 0);
+  ASSERT_EQ(run("var a = 0.5, n in (a || (n = 5)) + n"), 1);
+  ASSERT_EQ(run("1 < 2 && 2 < 3 || 0"), 1);
+  ASSERT_EQ(run("1 + 1 == 2 * 1 != 0"), 1);
+}
+
+TEST(InterpTest, CallTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def add3(a b c) a + b * c;"));
+  par.getNextToken();
+  auto def = par.definition();
+  ASSERT_NE(def, nullptr);
+  ASSERT_NE(def->codeGen(par.operators()), nullptr);
+  global::gJIT()->addModule(std::move(global::gModule()));
+
+  ASSERT_EQ(run("add3(1, 2, 3) + add3(0, 1, 1)"), 8);
+  // unknown functions and wrong arities are left to the JIT to report.
+  std::unique_ptr<parser::Function> fn;
+  ASSERT_EQ(compile("nope(1)", fn), nullptr);
+  ASSERT_EQ(compile("add3(1)", fn), nullptr);
+  ASSERT_EQ(compile("x", fn), nullptr);
+}
+
+}  // namespace interp
+}  // namespace kaso
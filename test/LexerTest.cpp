@@ -1,5 +1,8 @@
 #include <gtest/gtest.h>
+#include <cmath>
 #include "lexer/Lexer.h"
+#include "lexer/Number.h"
+#include "lexer/Scanner.h"
 
 namespace kaso {
 namespace lexer {
@@ -9,6 +12,10 @@ const std::map<std::string, std::vector<lexer::Token>> data = {
     {"3 > 4;",
      {Token::Number, Token::OpGreat, Token::Number, Token::Semicolon}},
 
+    {"a != !b==c;",
+     {Token::Identifier, Token::OpNE, Token::OpNegate, Token::Identifier,
+      Token::OpEQ, Token::Identifier, Token::Semicolon}},
+
     {"def foo(x y) x+foo(y, 4.0);",
      {Token::Def, Token::Identifier, Token::LeftParen, Token::Identifier,
       Token::Identifier, Token::RightParen, Token::Identifier, Token::OpAdd,
@@ -82,5 +89,140 @@ TEST(GetTokenTest, GetToken) {
   }
 }
 
+TEST(GetTokenTest, GetBufferToken) {
+  for (const auto& kv : data) {
+    Lexer lex(llvm::StringRef(kv.first));
+    assertTokens(lex, kv.second);
+  }
+}
+
+TEST(GetTokenTest, BufferTokenViews) {
+  std::string src = "def foo(x) # comment\n  x >= 4.5;";
+  Lexer lex(src);
+
+  ASSERT_EQ(lex.getTok(), Token::Def);
+  ASSERT_EQ(lex.tokOffset(), 0);
+  ASSERT_EQ(lex.getTok(), Token::Identifier);
+  ASSERT_EQ(lex.strRef(), "foo");
+  ASSERT_EQ(lex.strRef().data(), src.data() + 4);
+  ASSERT_EQ(lex.getTok(), Token::LeftParen);
+  ASSERT_EQ(lex.getTok(), Token::Identifier);
+  ASSERT_EQ(lex.getTok(), Token::RightParen);
+  ASSERT_EQ(lex.getTok(), Token::Identifier);
+  ASSERT_EQ(lex.tokOffset(), 23);
+  ASSERT_EQ(lex.getTok(), Token::OpGE);
+  ASSERT_EQ(lex.strVal(), ">=");
+  ASSERT_EQ(lex.getTok(), Token::Number);
+  ASSERT_EQ(lex.numVal(), 4.5);
+  ASSERT_EQ(lex.tokLength(), 3);
+  ASSERT_EQ(lex.getTok(), Token::Semicolon);
+  ASSERT_EQ(lex.getTok(), Token::Eof);
+}
+
+TEST(ScannerTest, Kernels) {
+  auto initial = scan::activeIsa();
+  for (auto isa : {scan::Isa::Scalar, scan::Isa::SSE2, scan::Isa::AVX2}) {
+    if (!scan::setIsa(isa)) {
+      continue;
+    }
+    // runs crossing and ending at every vector width boundary.
+    for (size_t n = 0; n < 80; n++) {
+      std::string ident(n, 'a');
+      ident += "Z9";
+      std::string src = ident + "+ \t\n" + std::string(n, ' ') + "x#c\n";
+      auto b = src.data(), e = b + src.size();
+
+      auto p = scan::skipIdent(b, e);
+      ASSERT_EQ(p - b, n + 2) << scan::isaName(isa);
+      p = scan::skipSpace(p + 1, e);
+      ASSERT_EQ(*p, 'x') << scan::isaName(isa);
+      ASSERT_EQ(scan::skipLine(b, e), b + ident.size() + 3);
+      ASSERT_EQ(scan::skipIdent(e, e), e);
+      ASSERT_EQ(scan::skipLine(p + 3, e), e - 1);
+    }
+
+    for (const auto& kv : data) {
+      Lexer lex(llvm::StringRef(kv.first));
+      assertTokens(lex, kv.second);
+    }
+  }
+  scan::setIsa(initial);
+}
+
+TEST(NumberTest, Parse) {
+  const std::pair<const char*, double> good[] = {
+      {"0", 0.0},
+      {"4.0", 4.0},
+      {".5", 0.5},
+      {"5.", 5.0},
+      {"1e-9", 1e-9},
+      {"2.5E+3", 2500.0},
+      {"0.1", 0.1},
+      {"123456789012345678901234567890", 123456789012345678901234567890.0},
+      {"9007199254740993", 9007199254740992.0},  // tie, rounds to even
+      {"1e23", 1e23},
+      {"123e25", 123e25},
+      {"2.2250738585072011e-308", 2.2250738585072011e-308},
+      {"4.9e-324", 4.9e-324},
+      {"1e-400", 0.0},
+      {"1e400", HUGE_VAL},
+      {"0x1p3", 8.0},
+      {"0x1.8p1", 3.0},
+      {"0xff", 255.0},
+      {"0x.8", 0.5},
+      {"0x1.fffffffffffff8p0", 2.0},  // tie, rounds to even
+      {"0x1p-1074", 4.9406564584124654e-324},
+      {"0x1p-1075", 0.0},
+      {"0x1.000001p-1075", 4.9406564584124654e-324},
+      {"0x1p1024", HUGE_VAL}};
+  for (const auto& kv : good) {
+    double val = -1;
+    ASSERT_TRUE(parseNumber(kv.first, val)) << kv.first;
+    ASSERT_EQ(val, kv.second) << kv.first;
+  }
+
+  for (auto bad : {"1.2.3", "1..", ".", "1e", "1e+", "0x", "0x1p", "12abc",
+                   "0x1.2.3p1"}) {
+    double val;
+    ASSERT_FALSE(parseNumber(bad, val)) << bad;
+  }
+
+  for (auto src : {"1.2.3;", "12abc;"}) {
+    std::stringstream ss(src);
+    Lexer lex(ss);
+    ASSERT_EQ(lex.getTok(), Token::Error) << src;
+    ASSERT_EQ(lex.getTok(), Token::Semicolon) << src;
+
+    Lexer buf{llvm::StringRef(src)};
+    ASSERT_EQ(buf.getTok(), Token::Error) << src;
+    ASSERT_EQ(buf.getTok(), Token::Semicolon) << src;
+  }
+
+  for (auto src : {"1e-9-x", "0x1p-2-x"}) {
+    std::stringstream ss(src);
+    Lexer lex(ss);
+    ASSERT_EQ(lex.getTok(), Token::Number) << src;
+    ASSERT_EQ(lex.getTok(), Token::OpSub) << src;
+
+    Lexer buf{llvm::StringRef(src)};
+    ASSERT_EQ(buf.getTok(), Token::Number) << src;
+    ASSERT_EQ(buf.getTok(), Token::OpSub) << src;
+  }
+}
+
+TEST(SymbolTest, Intern) {
+  auto foo = intern("foo");
+  ASSERT_EQ(foo, intern(std::string("foo")));
+  ASSERT_NE(foo, intern("bar"));
+  ASSERT_EQ(symbolName(foo), "foo");
+
+  std::stringstream ss("foo def");
+  Lexer lex(ss);
+  ASSERT_EQ(lex.getTok(), Token::Identifier);
+  ASSERT_EQ(lex.symVal(), foo);
+  ASSERT_EQ(lex.getTok(), Token::Def);
+  ASSERT_EQ(lex.symVal(), intern("def"));
+}
+
 }  // namespace lexer
 }  // namespace kaso
@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+#include <limits>
+#include "global/Global.h"
+#include "memo/Memo.h"
+#include "parser/Parser.h"
+
+namespace kaso {
+namespace memo {
+
+TEST(MemoTest, CacheTest) {
+  Cache c(lexer::intern("f"), 2, 100);
+  ASSERT_EQ(c.capacity(), 128);
+
+  double a[] = {1, 2}, b[] = {2, 1};
+  double nan[] = {std::numeric_limits<double>::quiet_NaN(), -0.0};
+  ASSERT_EQ(c.find(a), nullptr);
+  c.insert(a, 3);
+  c.insert(b, 4);
+  c.insert(nan, 5);
+  ASSERT_EQ(*c.find(a), 3);
+  ASSERT_EQ(*c.find(b), 4);
+  ASSERT_EQ(*c.find(nan), 5);
+  nan[1] = 0.0;
+  ASSERT_EQ(c.find(nan), nullptr);
+  c.insert(a, 6);
+  ASSERT_EQ(*c.find(a), 6);
+  ASSERT_EQ(c.size(), 3);
+  ASSERT_EQ(c.hits(), 4);
+  ASSERT_EQ(c.misses(), 2);
+
+  // the table never grows.
+  for (int i = 0; i < 10000; i++) {
+    double key[] = {static_cast<double>(i), 0};
+    c.insert(key, i);
+  }
+  ASSERT_EQ(c.capacity(), 128);
+  ASSERT_LE(c.size(), 128);
+  c.clear();
+  ASSERT_EQ(c.size(), 0);
+  ASSERT_EQ(c.find(a), nullptr);
+}
+
+TEST(MemoTest, WrapTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  parser::Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def memo fib(x) if x < 3 then 1 else fib(x - 1) + fib(x - 2);"));
+  par.getNextToken();
+  auto fn = par.definition();
+  ASSERT_NE(fn, nullptr);
+  ASSERT_TRUE(fn->isMemo());
+  auto f = fn->codeGen(par.operators());
+  ASSERT_NE(f, nullptr);
+  ASSERT_EQ(f->getName(), "fib");
+  global::gJIT()->addModule(std::move(global::gModule()));
+
+  auto sym = global::gJIT()->findSymbol("fib");
+  auto fib = (double (*)(double))(intptr_t)llvm::cantFail(sym.getAddress());
+  // exponential without the cache.
+  ASSERT_EQ(fib(70), 190392490709135.0);
+  auto& c = cacheFor(lexer::intern("fib"), 1);
+  ASSERT_EQ(c.size(), 70);
+  ASSERT_EQ(c.misses(), 70);
+  ASSERT_EQ(fib(70), 190392490709135.0);
+  ASSERT_EQ(c.misses(), 70);
+  ASSERT_EQ(caches().size(), 1);
+}
+
+}  // namespace memo
+}  // namespace kaso
@@ -1,10 +1,58 @@
 #include <gtest/gtest.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <cmath>
+#include "global/FastMath.h"
+#include "global/JitModules.h"
+#include "global/MathLib.h"
+#include "global/Target.h"
 #include "lexer/Lexer.h"
+#include "parser/BatchParser.h"
+#include "parser/FlatExpr.h"
 #include "parser/Parser.h"
+#include "parser/Simplify.h"
 
 namespace kaso {
 namespace parser {
 
+namespace {
+
+// prints f(x y) with the body emitted by emitBody.
+template <typename F>
+std::string emitFunction(F emitBody) {
+  Prototype proto(lexer::intern("f"), {lexer::intern("x"), lexer::intern("y")});
+  auto f = proto.codeGen();
+  auto bb = llvm::BasicBlock::Create(global::gContext(), "entry", f);
+  global::gBuilder().SetInsertPoint(bb);
+  global::gNamedValues().clear();
+  auto idx = 0;
+  for (auto& arg : f->args()) {
+    global::gNamedValues()[proto.getArgs()[idx++]] = &arg;
+  }
+  global::gBuilder().CreateRet(emitBody());
+
+  std::string ir;
+  llvm::raw_string_ostream os(ir);
+  f->print(os);
+  f->eraseFromParent();
+  return os.str();
+}
+
+// compiles the definitions in src, each followed by ';', into the module.
+void compile(const char* src) {
+  Parser par(std::make_shared<const lexer::TokenBuffer>(src));
+  par.getNextToken();
+  while (par.curToken() == lexer::Token::Def) {
+    auto def = par.definition();
+    ASSERT_NE(def, nullptr);
+    ASSERT_NE(def->codeGen(par.operators()), nullptr);
+    par.getNextToken();  // eat ';'
+  }
+}
+
+}  // namespace
+
 TEST(ParserTest, DefinitionTest1) {
   std::stringstream ss;
   ss << "def foo(x y) x+foo(y, 4.0);" << std::endl;
@@ -28,6 +76,87 @@ TEST(ParserTest, DefinitionTest2) {
   ASSERT_EQ(par.topLevelExpr(), nullptr);
 }
 
+TEST(ParserTest, SourceTest) {
+  // a stream keeps the tokens read for a definition, spelled out.
+  std::stringstream ss;
+  ss << "def binary : 5 (a b)  a*2.5e0 + b # comment\n; def g() 1;";
+  Parser par{lexer::Lexer(ss)};
+  par.getNextToken();
+  auto fn = par.definition();
+  ASSERT_NE(fn, nullptr);
+  auto& src = fn->source();
+  ASSERT_EQ(src.tokens->source(), "def binary : 5 ( a b ) a * 2.5e0 + b ");
+  ASSERT_EQ(src.begin, 0);
+  ASSERT_EQ(src.end, src.tokens->size() - 1);
+
+  // a token buffer is shared, the definition is a range of it.
+  auto tokens = std::make_shared<const lexer::TokenBuffer>(
+      "1; def memo f(x) x * 2; f(1);");
+  Parser buf(tokens);
+  buf.getNextToken();
+  buf.getNextToken();
+  buf.getNextToken();
+  auto def = buf.definition();
+  ASSERT_NE(def, nullptr);
+  ASSERT_EQ(def->source().tokens, tokens);
+  ASSERT_EQ(tokens->kind(def->source().begin), lexer::Token::Def);
+  ASSERT_EQ(tokens->kind(def->source().end), lexer::Token::Semicolon);
+
+  Parser again(tokens, def->source().begin, def->source().end);
+  again.getNextToken();
+  auto copy = again.definition();
+  ASSERT_NE(copy, nullptr);
+  ASSERT_EQ(copy->getName(), def->getName());
+  ASSERT_TRUE(copy->isMemo());
+  ASSERT_EQ(again.getNextToken(), lexer::Token::Eof);
+}
+
+TEST(ParserTest, AnnotationTest) {
+  // 'memo' and 'fast' annotate a definition, and are names everywhere else.
+  const char* src =
+      "def memo(x) x; def g(memo) memo(memo); def memo h(x) x;"
+      "def fast(a b) a; def fast(nsz) fast(y) y;"
+      "def fast memo fast(x) x;";
+  struct Def {
+    const char* name;
+    size_t arity;
+    bool memo;
+    unsigned fastMath;
+  };
+  const Def expected[] = {{"memo", 1, false, 0},
+                          {"g", 1, false, 0},
+                          {"h", 1, true, 0},
+                          {"fast", 2, false, 0},
+                          {"fast", 1, false, global::kNoSignedZeros},
+                          {"fast", 1, true, global::kFastAll}};
+
+  auto check = [&](Parser& par) {
+    par.getNextToken();
+    for (auto& d : expected) {
+      auto fn = par.definition();
+      ASSERT_NE(fn, nullptr) << d.name;
+      ASSERT_EQ(fn->getName(), lexer::intern(d.name));
+      ASSERT_EQ(fn->getProto().getArgs().size(), d.arity) << d.name;
+      ASSERT_EQ(fn->isMemo(), d.memo) << d.name;
+      ASSERT_EQ(fn->fastMath(), d.fastMath) << d.name;
+      par.getNextToken();  // eat ';'
+    }
+  };
+  auto tokens = std::make_shared<const lexer::TokenBuffer>(src);
+  Parser buffered(tokens);
+  check(buffered);
+  std::stringstream ss;
+  ss << src;
+  Parser streamed((lexer::Lexer(ss)));
+  check(streamed);
+
+  auto& starts = tokens->itemStarts();
+  for (size_t i = 0; i != 6; ++i) {
+    auto head = prototypeStart(*tokens, starts[i]);
+    ASSERT_EQ(tokens->symVal(head), lexer::intern(expected[i].name));
+  }
+}
+
 TEST(ParserTest, ExternTest) {
   std::stringstream ss;
   ss << "extern sin(a);" << std::endl;
@@ -40,5 +169,587 @@ TEST(ParserTest, ExternTest) {
   ASSERT_EQ(lex.getTok(), lexer::Token::Eof);
 }
 
+TEST(ParserTest, TokenBufferTest) {
+  auto tokens = std::make_shared<const lexer::TokenBuffer>(
+      "extern sin(a); def foo(x y) x+foo(y, 4.0); foo(1, 2) def bar(z) z");
+  ASSERT_EQ(tokens->kind(tokens->size() - 1), lexer::Token::Eof);
+  ASSERT_EQ(tokens->itemStarts(), std::vector<uint32_t>({0, 6, 21, 27}));
+  ASSERT_EQ(tokens->text(1), "sin");
+  ASSERT_EQ(tokens->symVal(1), lexer::intern("sin"));
+  ASSERT_EQ(tokens->numVal(18), 4.0);
+
+  Parser par(tokens);
+  ASSERT_EQ(par.getNextToken(), lexer::Token::Extern);
+  ASSERT_EQ(par.peekToken(2), lexer::Token::LeftParen);
+  ASSERT_NE(par.externDef(), nullptr);
+  ASSERT_EQ(par.curToken(), lexer::Token::Semicolon);
+  ASSERT_EQ(par.getNextToken(), lexer::Token::Def);
+  ASSERT_NE(par.definition(), nullptr);
+  ASSERT_EQ(par.tokenIndex(), 20);
+
+  // a slice ends in Eof even though the buffer goes on.
+  Parser slice(tokens, 21, 27);
+  ASSERT_EQ(slice.getNextToken(), lexer::Token::Identifier);
+  ASSERT_NE(slice.topLevelExpr(), nullptr);
+  ASSERT_EQ(slice.curToken(), lexer::Token::Eof);
+}
+
+TEST(ParserTest, ItemHashTest) {
+  lexer::TokenBuffer a("def f(x) g(x) + h(g(x), x);\n%load lib.ks\n1");
+  lexer::TokenBuffer b("def f(x)  g(x)+h(g(x),x) # same\n;%load lib.ks\n1");
+  lexer::TokenBuffer c("def f(x) g(x) + h(g(x), 2);\n%load lib.ks\n1");
+  ASSERT_EQ(a.itemStarts(), b.itemStarts());
+  ASSERT_EQ(a.itemStarts().size(), 3);
+  ASSERT_EQ(a.kind(a.itemStarts()[1]), lexer::Token::Command);
+  ASSERT_EQ(a.text(a.itemStarts()[1]), "%load lib.ks");
+  ASSERT_EQ(a.hash(0, a.size()), b.hash(0, b.size()));
+  ASSERT_NE(a.hash(0, a.size()), c.hash(0, c.size()));
+  ASSERT_EQ(a.hash(19, a.size()), c.hash(19, c.size()));
+
+  Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def f(x) g(x) + h(g(x), x)"));
+  par.getNextToken();
+  auto fn = par.definition();
+  ASSERT_NE(fn, nullptr);
+  auto callees = fn->callees();
+  std::sort(callees.begin(), callees.end());
+  auto expected = std::vector<lexer::Symbol>{lexer::intern("g"),
+                                             lexer::intern("h")};
+  std::sort(expected.begin(), expected.end());
+  ASSERT_EQ(callees, expected);
+}
+
+TEST(ParserTest, SimplifyTest) {
+  // parsers own the arenas of the trees they return.
+  std::vector<std::unique_ptr<Parser>> parsers;
+  Arena arena;
+  auto simplified = [&](const char* src) {
+    parsers.push_back(std::make_unique<Parser>(
+        std::make_shared<const lexer::TokenBuffer>(src)));
+    parsers.back()->getNextToken();
+    return simplify(parsers.back()->expression(), arena,
+                    {lexer::intern("x")});
+  };
+  auto value = [](Expr* e) { return llvm::cast<NumberExpr>(e)->getVal(); };
+
+  ASSERT_EQ(value(simplified("1 + 2 * 3 - (4 < 5)")), 6.0);
+  ASSERT_EQ(value(simplified("if 2 < 1 then x else 3 * 0.5")), 1.5);
+  ASSERT_EQ(value(simplified("for i = 0, 0 in i * 2")), 0.0);
+  ASSERT_EQ(simplified("x * 1 - 0")->kind(), Expr::Kind::Variable);
+  ASSERT_EQ(simplified("g(x * (2 - 1))")->kind(), Expr::Kind::Call);
+  ASSERT_EQ(simplified("if x then 1 + 1 else 0")->kind(), Expr::Kind::If);
+
+  // not exact for x = -0, and the loop body has a call.
+  ASSERT_EQ(simplified("x + 0")->kind(), Expr::Kind::Binary);
+  ASSERT_EQ(simplified("for i = 0, 0 in g(i)")->kind(), Expr::Kind::For);
+
+  // y is unbound and g may be unknown: codegen has to see them.
+  ASSERT_EQ(simplified("if 0 then g() else 1")->kind(), Expr::Kind::If);
+  ASSERT_EQ(simplified("if 1 then x else y")->kind(), Expr::Kind::If);
+  ASSERT_EQ(simplified("0 && y")->kind(), Expr::Kind::Binary);
+  ASSERT_EQ(simplified("for i = 0, 0 in i + y")->kind(), Expr::Kind::For);
+}
+
+TEST(ParserTest, SimplifyNamesTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  // pruned branches still report unknown names.
+  for (auto src : {"def f() if 0 then nosuch() else 1",
+                   "def f() if 1 then 1 else y",
+                   "def f(x) 0 && nosuch(x)",
+                   "def f() for i = 0, 0 in i + y"}) {
+    Parser par(std::make_shared<const lexer::TokenBuffer>(src));
+    par.getNextToken();
+    auto def = par.definition();
+    ASSERT_NE(def, nullptr) << src;
+    ASSERT_EQ(def->codeGen(par.operators()), nullptr) << src;
+  }
+  compile("def f(x) if 0 then x else 1;");
+}
+
+TEST(ParserTest, OperatorTableTest) {
+  OperatorTable ops;
+  ASSERT_EQ(ops.precedence(lexer::Token::OpMul), 40);
+  ASSERT_EQ(ops.get(lexer::Token::OpAdd).binary, Lowering::Builtin);
+  ASSERT_EQ(ops.precedence(lexer::Token::OpColon), -1);
+  ASSERT_EQ(ops.precedence(lexer::Token::Semicolon), -1);
+  ASSERT_TRUE(ops.get(lexer::Token::OpColon).definableBinary);
+  ASSERT_FALSE(ops.get(lexer::Token::Comma).definableBinary);
+
+  auto saved = ops.get(lexer::Token::OpColon);
+  auto fn = operatorFunctionName(lexer::Token::OpColon, true);
+  ops.defineBinary(lexer::Token::OpColon, 1, fn);
+  ASSERT_EQ(ops.precedence(lexer::Token::OpColon), 1);
+  ASSERT_EQ(ops.get(lexer::Token::OpColon).binary, Lowering::User);
+  ASSERT_EQ(ops.get(lexer::Token::OpColon).binaryFn, lexer::intern("binary:"));
+
+  // tables are independent of each other.
+  ASSERT_EQ(OperatorTable().precedence(lexer::Token::OpColon), -1);
+
+  ops.restore(lexer::Token::OpColon, saved);
+  ASSERT_EQ(ops.precedence(lexer::Token::OpColon), -1);
+}
+
+TEST(ParserTest, FlatExprTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  Prototype(lexer::intern("g"), {lexer::intern("a"), lexer::intern("b")})
+      .codeGen();
+
+  auto tokens = std::make_shared<const lexer::TokenBuffer>(
+      "x * (y + 2) - g(x, if x < y then y else for i = 0, i < x in g(i, y))");
+  Parser par(tokens);
+  par.getNextToken();
+  auto e = par.expression();
+  ASSERT_NE(e, nullptr);
+
+  auto flat = FlatExpr::flatten(*e);
+  ASSERT_EQ(flat.size(), 21);
+  ASSERT_EQ(flat[flat.root()].kind, Expr::Kind::Binary);
+  ASSERT_EQ(flat[flat.root()].first, 0);
+  ASSERT_TRUE(flat[flat.root()].control);
+  // x * (y + 2) is straight-line code.
+  ASSERT_EQ(flat[4].first, 0);
+  ASSERT_FALSE(flat[4].control);
+
+  auto tree = emitFunction([&] { return e->codeGen(); });
+  auto linear = emitFunction([&] { return flat.codeGen(); });
+  ASSERT_EQ(linear, tree);
+}
+
+TEST(ParserTest, VarTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  auto tokens = std::make_shared<const lexer::TokenBuffer>(
+      "var s, i = 1 in (for j = 0, j < x in s = s + (i = i * y)) + s");
+  Parser par(tokens);
+  par.getNextToken();
+  auto e = par.expression();
+  ASSERT_NE(e, nullptr);
+  ASSERT_EQ(e->kind(), Expr::Kind::Var);
+
+  auto flat = FlatExpr::flatten(*e);
+  auto tree = emitFunction([&] { return e->codeGen(); });
+  auto linear = emitFunction([&] { return flat.codeGen(); });
+  ASSERT_EQ(linear, tree);
+
+  // mem2reg leaves no stack slots behind, not even for the arguments.
+  Parser def(std::make_shared<const lexer::TokenBuffer>(
+      "def sum(n) var s in (for i = 1, i < n in s = s + (n = n)) + s;"));
+  def.getNextToken();
+  auto fn = def.definition();
+  ASSERT_NE(fn, nullptr);
+  auto f = fn->codeGen(def.operators());
+  ASSERT_NE(f, nullptr);
+  for (auto& bb : *f) {
+    for (auto& inst : bb) {
+      ASSERT_FALSE(llvm::isa<llvm::AllocaInst>(inst));
+    }
+  }
+
+  // only variables can be assigned.
+  Parser bad(std::make_shared<const lexer::TokenBuffer>("1 = 2"));
+  bad.getNextToken();
+  ASSERT_EQ(bad.expression(), nullptr);
+}
+
+TEST(ParserTest, TailCallTest) {
+  global::init();
+  // baseline code, so the guarantee does not hang on the optimizer.
+  global::initModuleAndPassManager(false);
+  Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "extern odd(n);"
+      "def even(n) if n < 1 then 1 else odd(n - 1);"
+      "def odd(n) if n < 1 then 0 else even(n - 1);"
+      "def count(n acc) if n < 1 then acc else count(n - 1, acc + 1);"));
+  par.getNextToken();
+  ASSERT_NE(par.externDef()->codeGen(), nullptr);
+  std::vector<llvm::Function*> fs;
+  for (int i = 0; i < 3; i++) {
+    par.getNextToken();  // eat ';'
+    auto def = par.definition();
+    ASSERT_NE(def, nullptr);
+    fs.push_back(def->codeGen(par.operators()));
+    ASSERT_NE(fs.back(), nullptr);
+  }
+
+  // mutual recursion jumps, self recursion loops.
+  auto mustTail = 0;
+  for (auto& bb : *fs[0]) {
+    for (auto& inst : bb) {
+      auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+      mustTail += call != nullptr && call->isMustTailCall();
+    }
+  }
+  ASSERT_EQ(mustTail, 1);
+  for (auto& bb : *fs[2]) {
+    for (auto& inst : bb) {
+      ASSERT_FALSE(llvm::isa<llvm::CallInst>(inst));
+    }
+  }
+
+  global::gJIT()->addModule(std::move(global::gModule()));
+  auto lookup = [](const char* name) {
+    auto sym = global::gJIT()->findSymbol(name);
+    return static_cast<intptr_t>(llvm::cantFail(sym.getAddress()));
+  };
+  auto even = (double (*)(double))lookup("even");
+  auto count = (double (*)(double, double))lookup("count");
+  // a million frames would overflow the stack.
+  ASSERT_EQ(even(1000001), 0);
+  ASSERT_EQ(count(1000000, 0), 1000000);
+}
+
+TEST(ParserTest, InlineTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def binary : 5 (a b) if a then 1 else if b then 1 else 0;"
+      "def either(x y) x : y;"));
+  par.getNextToken();
+  auto op = par.definition();
+  ASSERT_NE(op, nullptr);
+  ASSERT_NE(op->codeGen(par.operators()), nullptr);
+  global::gJIT()->addModule(std::move(global::gModule()));
+
+  // the operator lives in another module, but its IR is imported.
+  global::initModuleAndPassManager();
+  par.getNextToken();  // eat ';'
+  auto def = par.definition();
+  ASSERT_NE(def, nullptr);
+  auto f = def->codeGen(par.operators());
+  ASSERT_NE(f, nullptr);
+  for (auto& bb : *f) {
+    for (auto& inst : bb) {
+      ASSERT_FALSE(llvm::isa<llvm::CallInst>(inst));
+    }
+  }
+  global::gJIT()->addModule(std::move(global::gModule()));
+  global::initModuleAndPassManager();
+
+  auto sym = global::gJIT()->findSymbol("either");
+  auto either = (double (*)(double, double))(intptr_t)llvm::cantFail(
+      sym.getAddress());
+  ASSERT_EQ(either(0, 0), 0);
+  ASSERT_EQ(either(0, 2), 1);
+}
+
+TEST(ParserTest, PipelineTest) {
+  global::init();
+  ASSERT_TRUE(global::checkPasses("licm, loop-unroll,gvn"));
+  ASSERT_TRUE(global::checkPasses(""));
+  ASSERT_FALSE(global::checkPasses("licm,nope"));
+
+  std::vector<global::Pipeline> pipelines(5);
+  for (unsigned level = 0; level < 4; level++) {
+    pipelines[level].level = level;
+  }
+  pipelines[4].passes = "licm,loop-unroll,instcombine";
+  for (auto& p : pipelines) {
+    global::setPipeline(p);
+    global::initModuleAndPassManager();
+    Parser par(std::make_shared<const lexer::TokenBuffer>(
+        "def sum(n) var s in (for i = 0, i < n in s = s + i) + s;"));
+    par.getNextToken();
+    auto def = par.definition();
+    ASSERT_NE(def, nullptr);
+    ASSERT_NE(def->codeGen(par.operators()), nullptr);
+    global::gJIT()->addModule(global::takeModule());
+
+    auto sym = global::gJIT()->findSymbol("sum");
+    auto sum = (double (*)(double))(intptr_t)llvm::cantFail(sym.getAddress());
+    ASSERT_EQ(sum(100), 5050);
+  }
+  global::setPipeline(global::Pipeline());
+  global::initModuleAndPassManager();
+}
+
+TEST(ParserTest, FastMathTest) {
+  global::init();
+  global::initModuleAndPassManager(false);
+  Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "def fast(contract nsz) memo f(x) x * 2 + 1;"
+      "def g(x) x * 2 + 1;"
+      "def fast(nsz bogus) h(x) x;"));
+  par.getNextToken();
+  auto f = par.definition();
+  ASSERT_NE(f, nullptr);
+  ASSERT_TRUE(f->isMemo());
+  ASSERT_EQ(f->fastMath(), global::kContract | global::kNoSignedZeros);
+  auto fn = f->codeGen(par.operators());
+  ASSERT_NE(fn, nullptr);
+  auto body = global::gModule()->getFunction("f.uncached");
+  ASSERT_NE(body, nullptr);
+  ASSERT_EQ(body->getFnAttribute("no-signed-zeros-fp-math").getValueAsString(),
+            "true");
+  auto add = llvm::cast<llvm::Instruction>(
+      body->getEntryBlock().getTerminator()->getOperand(0));
+  ASSERT_TRUE(add->hasAllowContract());
+  ASSERT_TRUE(add->hasNoSignedZeros());
+  ASSERT_FALSE(add->hasNoNaNs());
+
+  // strict unless the session says otherwise.
+  par.getNextToken();  // eat ';'
+  auto g = par.definition();
+  ASSERT_NE(g, nullptr);
+  ASSERT_EQ(g->fastMath(), 0);
+  global::setFastMath(global::kNoNaNs);
+  fn = g->codeGen(par.operators());
+  global::setFastMath(0);
+  ASSERT_NE(fn, nullptr);
+  add = llvm::cast<llvm::Instruction>(
+      fn->getEntryBlock().getTerminator()->getOperand(0));
+  ASSERT_TRUE(add->hasNoNaNs());
+  ASSERT_FALSE(add->hasAllowContract());
+
+  par.getNextToken();  // eat ';'
+  ASSERT_EQ(par.definition(), nullptr);
+
+  // a strict callee inlined into a fast caller: the backend must not
+  // compile the pair as fast-math.
+  global::initModuleAndPassManager(false);
+  compile("def strict(x) x * 2 + 1;");
+  global::gJIT()->addModule(global::takeModule());
+  global::initModuleAndPassManager();
+  compile("def fast loose(x) strict(x) + 1;");
+  auto loose = global::gModule()->getFunction("loose");
+  ASSERT_TRUE(global::gModule()->getFunction("strict")->use_empty());
+  for (auto attr : {"unsafe-fp-math", "no-nans-fp-math", "no-infs-fp-math",
+                    "no-signed-zeros-fp-math"}) {
+    ASSERT_NE(loose->getFnAttribute(attr).getValueAsString(), "true") << attr;
+  }
+  global::initModuleAndPassManager();
+}
+
+TEST(ParserTest, LogicTest) {
+  global::init();
+  global::initModuleAndPassManager();
+  Prototype(lexer::intern("g"), {lexer::intern("a"), lexer::intern("b")})
+      .codeGen();
+  Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "x / y >= 1 && g(x, y) || x != y;"
+      "def binary && 6 (a b) a * b;"
+      "2 && 3;"));
+  par.getNextToken();
+  auto e = par.expression();
+  ASSERT_NE(e, nullptr);
+  ASSERT_EQ(llvm::cast<BinaryExpr>(e)->getOp(), lexer::Token::OpLogicOr);
+
+  // the right operands get blocks of their own.
+  auto flat = FlatExpr::flatten(*e);
+  ASSERT_TRUE(flat[flat.root()].control);
+  auto tree = emitFunction([&] { return e->codeGen(); });
+  auto linear = emitFunction([&] { return flat.codeGen(); });
+  ASSERT_EQ(linear, tree);
+  ASSERT_NE(tree.find("rhs"), std::string::npos);
+
+  // a user-defined operator replaces the builtin.
+  par.getNextToken();  // eat ';'
+  auto def = par.definition();
+  ASSERT_NE(def, nullptr);
+  ASSERT_NE(def->codeGen(par.operators()), nullptr);
+  par.getNextToken();  // eat ';'
+  e = par.expression();
+  ASSERT_NE(e, nullptr);
+  ASSERT_NE(llvm::cast<BinaryExpr>(e)->getUserFn(), lexer::kNoSymbol);
+  global::initModuleAndPassManager();
+}
+
+TEST(ParserTest, MathTest) {
+  global::init();
+  ASSERT_EQ(global::mathIntrinsic("sin", 1), llvm::Intrinsic::sin);
+  ASSERT_EQ(global::mathIntrinsic("fmax", 2), llvm::Intrinsic::maxnum);
+  ASSERT_EQ(global::mathIntrinsic("sin", 2), llvm::Intrinsic::not_intrinsic);
+  ASSERT_EQ(global::mathIntrinsic("tan", 1), llvm::Intrinsic::not_intrinsic);
+  auto vecLib = llvm::TargetLibraryInfoImpl::NoLibrary;
+  ASSERT_TRUE(global::parseVecLib("SVML", vecLib));
+  ASSERT_EQ(vecLib, llvm::TargetLibraryInfoImpl::SVML);
+  ASSERT_FALSE(global::parseVecLib("nope", vecLib));
+
+  auto define = [](Parser& par) {
+    while (par.curToken() != lexer::Token::Eof) {
+      if (par.curToken() == lexer::Token::Extern) {
+        auto proto = par.externDef();
+        ASSERT_NE(proto, nullptr);
+        ASSERT_TRUE(proto->isExtern());
+        auto name = proto->getName();
+        global::storeProto(name, std::move(proto));
+      } else {
+        auto def = par.definition();
+        ASSERT_NE(def, nullptr);
+        ASSERT_NE(def->codeGen(par.operators()), nullptr);
+      }
+      par.getNextToken();  // eat ';'
+    }
+  };
+
+  // sin(0) folds, pow(x, 2) becomes x * x and sqrt(x) an instruction.
+  global::initModuleAndPassManager();
+  Parser par(std::make_shared<const lexer::TokenBuffer>(
+      "extern sin(x); extern pow(x y); extern sqrt(x);"
+      "def f(x) sin(0) + pow(x, 2) + sqrt(x);"));
+  par.getNextToken();
+  define(par);
+  auto m = global::takeModule();
+  for (auto& inst : m->getFunction("f")->getEntryBlock()) {
+    if (auto call = llvm::dyn_cast<llvm::CallInst>(&inst)) {
+      ASSERT_EQ(call->getCalledFunction()->getIntrinsicID(),
+                llvm::Intrinsic::sqrt);
+    }
+  }
+  global::gJIT()->addModule(std::move(m));
+  auto sym = global::gJIT()->findSymbol("f");
+  auto f = (double (*)(double))(intptr_t)llvm::cantFail(sym.getAddress());
+  ASSERT_EQ(f(4), 18);
+
+  // sin(x) does not change in the loop, so it moves out.
+  global::initModuleAndPassManager();
+  Parser loop(std::make_shared<const lexer::TokenBuffer>(
+      "def binary : 1 (x y) y;"
+      "def g(x n) var s in (for i = 0, i < n in s = s + sin(x)) : s;"));
+  loop.getNextToken();
+  define(loop);
+  m = global::takeModule();
+  for (auto& bb : *m->getFunction("g")) {
+    for (auto& inst : bb) {
+      if (llvm::isa<llvm::CallInst>(inst)) {
+        ASSERT_EQ(&bb, &m->getFunction("g")->getEntryBlock());
+      }
+    }
+  }
+  global::gJIT()->addModule(std::move(m));
+  sym = global::gJIT()->findSymbol("g");
+  auto g = (double (*)(double, double))(intptr_t)llvm::cantFail(
+      sym.getAddress());
+  ASSERT_DOUBLE_EQ(g(1, 9), 10 * std::sin(1.0));
+  global::initModuleAndPassManager();
+}
+
+TEST(ParserTest, SymbolTableTest) {
+  global::init();
+  // the newest definition of a name wins until its module is removed.
+  auto add = [](const char* src) {
+    global::initModuleAndPassManager();
+    Parser par(std::make_shared<const lexer::TokenBuffer>(src));
+    par.getNextToken();
+    auto def = par.definition();
+    EXPECT_NE(def, nullptr);
+    EXPECT_NE(def->codeGen(par.operators()), nullptr);
+    return global::gJIT()->addModule(global::takeModule());
+  };
+  auto k = [](const char* name) {
+    auto sym = global::gJIT()->findSymbol(name);
+    auto f = (double (*)())(intptr_t)llvm::cantFail(sym.getAddress());
+    return f();
+  };
+  add("def k1() 1;");
+  auto h2 = add("def k1() 2;");
+  auto h3 = add("def k2() k1();");
+  ASSERT_EQ(k("k1"), 2);
+  ASSERT_EQ(k("k2"), 2);
+  global::gJIT()->removeModule(h2);
+  ASSERT_EQ(k("k1"), 1);
+  global::gJIT()->removeModule(h3);
+  ASSERT_FALSE(global::gJIT()->findSymbol("k2"));
+  ASSERT_TRUE(global::gJIT()->findSymbol("sin"));
+  global::initModuleAndPassManager();
+}
+
+TEST(ParserTest, JitModulesTest) {
+  global::init();
+  global::JitModules modules;
+  global::initModuleAndPassManager();
+  compile("def j1() 1; def j2() 2;");
+  auto h = global::gJIT()->addModule(global::takeModule());
+  auto both = modules.add(h, 2);
+  global::initModuleAndPassManager();
+  compile("def j3() 3;");
+  auto one = modules.add(global::gJIT()->addModule(global::takeModule()), 1);
+  ASSERT_EQ(modules.live(both), 2);
+
+  // a module goes with the last of its definitions, and only then.
+  ASSERT_FALSE(modules.release(both).hasValue());
+  ASSERT_EQ(modules.live(both), 1);
+  ASSERT_TRUE(global::gJIT()->findSymbol("j1"));
+  auto last = modules.release(both);
+  ASSERT_TRUE(last.hasValue());
+  ASSERT_EQ(*last, h);
+  global::gJIT()->removeModule(*last);
+  ASSERT_FALSE(global::gJIT()->findSymbol("j2"));
+  ASSERT_EQ(modules.live(one), 1);
+  ASSERT_TRUE(global::gJIT()->findSymbol("j3"));
+  global::initModuleAndPassManager();
+}
+
+TEST(ParserTest, StoreBodyTest) {
+  global::init();
+  // s2 is compiled calling s1, not inlined, and its body is stored.
+  global::initModuleAndPassManager(false);
+  compile("def s1() 1; def s2() s1() + 10;");
+  global::gJIT()->addModule(global::takeModule());
+  global::initModuleAndPassManager(false);
+  compile("def s1() 2;");
+  global::gJIT()->addModule(global::takeModule());
+
+  // an import of s2 would call the new s1, so s2 is called instead.
+  global::initModuleAndPassManager();
+  compile("def s3() s2();");
+  ASSERT_TRUE(global::gModule()->getFunction("s2")->isDeclaration());
+  global::gJIT()->addModule(global::takeModule());
+  global::initModuleAndPassManager();
+  auto sym = global::gJIT()->findSymbol("s3");
+  auto s3 = (double (*)())(intptr_t)llvm::cantFail(sym.getAddress());
+  ASSERT_EQ(s3(), 11);
+}
+
+TEST(ParserTest, TargetTest) {
+  global::init();
+  using Features = std::vector<std::string>;
+  // the last entry for a feature wins, and the result is sorted.
+  ASSERT_EQ(global::activeFeatures("+c,-b,+a,+b, -a ,-d"),
+            Features({"b", "c"}));
+  ASSERT_EQ(global::activeFeatures(""), Features());
+
+  auto host = global::hostTarget();
+  ASSERT_FALSE(host.cpu.empty());
+  auto hostFeatures = global::activeFeatures(host.features);
+  ASSERT_TRUE(std::is_sorted(hostFeatures.begin(), hostFeatures.end()));
+
+  auto check = [](const std::string& cpu, const std::string& features) {
+    global::setTarget({cpu, features});
+    return global::checkTarget();
+  };
+  ASSERT_TRUE(check("", ""));
+  ASSERT_TRUE(check(host.cpu, ""));
+  ASSERT_FALSE(check("nosuch", ""));
+  ASSERT_FALSE(check("", "nosuch"));
+  ASSERT_FALSE(check("", "+nosuch"));
+  if (!hostFeatures.empty()) {
+    ASSERT_TRUE(check("", "-" + hostFeatures[0]));
+    ASSERT_FALSE(check("", "-" + hostFeatures[0] + ",-nosuch"));
+  }
+  global::setTarget(global::Target());
+}
+
+TEST(ParserTest, BatchTest) {
+  // later chunks must see ':' as an operator, or "1 : 2" splits in two.
+  std::string src = "def binary : 1 (a b) b;";
+  for (int i = 0; i < 200; i++) {
+    src += "def f" + std::to_string(i) + "(x) x : x + " + std::to_string(i) +
+           "; extern g" + std::to_string(i) + "(); 1 : 2;";
+  }
+  auto tokens = std::make_shared<const lexer::TokenBuffer>(src);
+  auto items = parseBatch(tokens, 4);
+  ASSERT_EQ(items.size(), 601);
+  ASSERT_EQ(items[0].kind, ParsedItem::Kind::Definition);
+  for (size_t i = 1; i < items.size(); i++) {
+    ASSERT_LT(items[i - 1].begin, items[i].begin);
+    auto kind = static_cast<ParsedItem::Kind>((i - 1) % 3);
+    ASSERT_EQ(items[i].kind, kind);
+    ASSERT_EQ(items[i].fn == nullptr, kind == ParsedItem::Kind::Extern);
+  }
+  ASSERT_EQ(parseBatch(tokens, 1).size(), 601);
+}
+
 }  // namespace parser
 }  // namespace kaso
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <llvm/ADT/SmallString.h>
+#include <llvm/ADT/StringRef.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <string>
+#include <vector>
+#include "shell/shell.h"
+
+namespace kaso {
+namespace shell {
+
+namespace {
+
+// a temporary .ks file holding src.
+std::string writeScript(const std::string& src) {
+  llvm::SmallString<128> path;
+  int fd;
+  EXPECT_FALSE(llvm::sys::fs::createTemporaryFile("shell", "ks", fd, path));
+  llvm::raw_fd_ostream os(fd, true);
+  os << src;
+  return path.str().str();
+}
+
+// what the shell prints to stderr running script in verbose mode.
+std::string run(const std::string& script, bool interpret,
+                unsigned moduleItems) {
+  Shell shell(writeScript(script), 1, interpret, 0, global::Pipeline(),
+              moduleItems);
+  testing::internal::CaptureStderr();
+  shell.repl(true);
+  return testing::internal::GetCapturedStderr();
+}
+
+// the "Evaluated to" values in out, in order.
+std::vector<std::string> results(llvm::StringRef out) {
+  std::vector<std::string> vals;
+  const llvm::StringRef tag = "Evaluated to ";
+  for (auto pos = out.find(tag); pos != llvm::StringRef::npos;
+       pos = out.find(tag, pos + 1)) {
+    vals.push_back(out.substr(pos + tag.size()).split('\n').first.str());
+  }
+  return vals;
+}
+
+// what the shell did, in order: "def" and "expr" as items are compiled,
+// then the value of each expression as it runs.
+std::vector<std::string> events(llvm::StringRef out) {
+  std::vector<std::string> evs;
+  llvm::SmallVector<llvm::StringRef, 64> lines;
+  out.split(lines, '\n');
+  for (auto line : lines) {
+    while (line.consume_front("ready> ")) {
+    }
+    if (line.startswith("Read function definition")) {
+      evs.push_back("def");
+    } else if (line.startswith("Read top-level expression")) {
+      evs.push_back("expr");
+    } else if (line.startswith("Evaluated to ")) {
+      evs.push_back(line.substr(13).str());
+    }
+  }
+  return evs;
+}
+
+}  // namespace
+
+TEST(ShellTest, FlushTest) {
+  // a module runs its expressions when it is full, before a name in it is
+  // defined again, at %flush and at the end of input.
+  const std::string script =
+      "def f() 1; f(); f() + 1; def f() 2; f();\n"
+      "%flush\n"
+      "f() * 3;\n";
+  using Events = std::vector<std::string>;
+  const Events batched = {"def",      "expr", "expr",     "1.000000",
+                          "2.000000", "def",  "expr",     "2.000000",
+                          "expr",     "6.000000"};
+  const Events single = {"def",  "expr",     "1.000000", "expr",
+                         "2.000000", "def",  "expr",     "2.000000",
+                         "expr", "6.000000"};
+  ASSERT_EQ(events(run(script, false, 64)), batched);
+  ASSERT_EQ(events(run(script, false, 3)), batched);
+  ASSERT_EQ(events(run(script, false, 2)), single);
+  ASSERT_EQ(events(run(script, false, 1)), single);
+}
+
+TEST(ShellTest, ModuleItemsTest) {
+  // f() must run before f is redefined, and g() keep calling the old f.
+  const std::string script =
+      "def f() 1; f(); def g() f() + 10; def f() 2; f(); g();\n"
+      "%flush\n"
+      "def h() 5; h(); h() + f();\n";
+  const std::vector<std::string> expected = {"1.000000", "2.000000",
+                                             "11.000000", "5.000000",
+                                             "7.000000"};
+  for (auto interpret : {false, true}) {
+    for (auto items : {1u, 2u, 64u}) {
+      ASSERT_EQ(results(run(script, interpret, items)), expected)
+          << "interpret " << interpret << ", module items " << items;
+    }
+  }
+}
+
+TEST(ShellTest, LoadTest) {
+  auto v1 = writeScript(
+      "def a(x) x + 1;\n"
+      "def b(x) a(x) * 2;\n"
+      "def c(x) x * 3;\n"
+      "b(1); c(1);\n");
+  auto v2 = writeScript(
+      "def a(x) x + 2;\n"
+      "def b(x) a(x) * 2;\n"
+      "def c(x) x * 3;\n"
+      "b(1); c(1);\n");
+  auto out = run("%load " + v1 + "\n%load " + v2 + "\n", false, 64);
+  auto second = llvm::StringRef(out).split("Loaded " + v1).second;
+  ASSERT_FALSE(second.empty());
+
+  // a changed and b calls it: both are compiled again, and c is not. Of
+  // the expressions only the one calling b runs again.
+  ASSERT_NE(second.find("5 items, 2 parsed, 2 compiled"),
+            llvm::StringRef::npos);
+  ASSERT_EQ(results(out),
+            std::vector<std::string>({"4.000000", "3.000000", "6.000000"}));
+}
+
+TEST(ShellTest, BatchErrorTest) {
+  auto bad = writeScript("1 2\n\n3 x\n");
+  auto out = run("def f(x y) x + y;\n%batch f " + bad + "\n", false, 1);
+  ASSERT_NE(out.find("LogError: line 3: x is not a number"),
+            std::string::npos);
+
+  auto wide = writeScript("1 2 3\n");
+  out = run("def f(x y) x + y;\n%batch f " + wide + "\n", false, 1);
+  ASSERT_NE(out.find("LogError: Incorrect # arguments passed"),
+            std::string::npos);
+}
+
+}  // namespace shell
+}  // namespace kaso
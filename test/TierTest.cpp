@@ -0,0 +1,59 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <thread>
+#include "global/Global.h"
+#include "parser/Parser.h"
+#include "tier/Tiering.h"
+
+namespace kaso {
+namespace tier {
+
+TEST(TierTest, HotDefinitionTest) {
+  global::init();
+  global::initModuleAndPassManager(false);
+  parser::Parser par(
+      std::make_shared<const lexer::TokenBuffer>("def sq(x) x * x;"));
+  par.getNextToken();
+  auto fn = par.definition();
+  ASSERT_NE(fn, nullptr);
+  auto f = fn->codeGen(par.operators());
+  ASSERT_NE(f, nullptr);
+
+  Tiering tiering(10, [&](const Profile&) {
+    global::initModuleAndPassManager(false);
+    fn->codeGen(par.operators());
+    auto m = std::move(global::gModule());
+    global::initModuleAndPassManager(false);
+    return m;
+  });
+  auto p = tiering.instrument(*f);
+  global::gJIT()->addModule(std::move(global::gModule()));
+  global::initModuleAndPassManager(false);
+  tiering.linked(*p);
+  auto baseline = p->target;
+
+  auto sym = global::gJIT()->findSymbol("sq");
+  auto sq = (double (*)(double))(intptr_t)llvm::cantFail(sym.getAddress());
+  for (int i = 0; i < 9; i++) {
+    ASSERT_EQ(sq(i), i * i);
+  }
+  ASSERT_EQ(p->state, Profile::State::Baseline);
+  ASSERT_EQ(sq(3), 9);
+  // the hot call polls too, so a quick worker may already be linked.
+  ASSERT_NE(p->state, Profile::State::Baseline);
+
+  for (int i = 0; i < 5000 && p->state != Profile::State::Optimized; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    tiering.poll();
+  }
+  ASSERT_EQ(p->state, Profile::State::Optimized);
+  ASSERT_NE(p->target, baseline);
+  // callers linked against the stub now reach the optimized code, which
+  // does not count.
+  ASSERT_EQ(sq(5), 25);
+  ASSERT_EQ(p->calls, 10);
+  ASSERT_TRUE(tiering.retire(*p).hasValue());
+}
+
+}  // namespace tier
+}  // namespace kaso